@@ -0,0 +1,337 @@
+#include "BatchForecaster.h"
+#include "DataBook.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+CandleRegression::CandleRegression()
+: n(0),
+  sumX(0.0),
+  sumX2(0.0),
+  sumY{0.0, 0.0, 0.0, 0.0},
+  sumXY{0.0, 0.0, 0.0, 0.0}
+{
+}
+
+void CandleRegression::add(int year, double open, double high, double low, double close)
+{
+    const double values[4] = {open, high, low, close};
+    ++n;
+    sumX += year;
+    sumX2 += year * year;
+    for (int k = 0; k < 4; ++k)
+    {
+        sumY[k] += values[k];
+        sumXY[k] += year * values[k];
+    }
+}
+
+void CandleRegression::remove(int year, double open, double high, double low, double close)
+{
+    const double values[4] = {open, high, low, close};
+    --n;
+    sumX -= year;
+    sumX2 -= year * year;
+    for (int k = 0; k < 4; ++k)
+    {
+        sumY[k] -= values[k];
+        sumXY[k] -= year * values[k];
+    }
+}
+
+void CandleRegression::shift(int years)
+{
+    // sum (x + d)^2 and sum (x + d) y from the sums over x, before sumX itself moves
+    sumX2 += 2.0 * years * sumX + static_cast<double>(n) * years * years;
+    for (int k = 0; k < 4; ++k)
+    {
+        sumXY[k] += years * sumY[k];
+    }
+    sumX += static_cast<double>(n) * years;
+}
+
+OHLC CandleRegression::predict(int year) const
+{
+    double values[4];
+    for (int k = 0; k < 4; ++k)
+    {
+        double slope = (n * sumXY[k] - sumX * sumY[k]) / (n * sumX2 - sumX * sumX);
+        double intercept = (sumY[k] - slope * sumX) / n;
+        values[k] = slope * year + intercept;
+    }
+    return OHLC{values[0], values[1], values[2], values[3]};
+}
+
+void CandleRegression::predict(int firstYear, int years, OHLC* out) const
+{
+    double slopes[4], intercepts[4];
+    for (int k = 0; k < 4; ++k)
+    {
+        slopes[k] = (n * sumXY[k] - sumX * sumY[k]) / (n * sumX2 - sumX * sumX);
+        intercepts[k] = (sumY[k] - slopes[k] * sumX) / n;
+    }
+    for (int i = 0; i < years; ++i)
+    {
+        int year = firstYear + i;
+        out[i] = OHLC{slopes[0] * year + intercepts[0], slopes[1] * year + intercepts[1],
+                      slopes[2] * year + intercepts[2], slopes[3] * year + intercepts[3]};
+    }
+}
+
+BatchForecaster::BatchForecaster()
+{
+}
+
+ForecastResults BatchForecaster::forecast(const std::vector<ForecastJob>& jobs, int horizon, unsigned int threadCount)
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    ForecastResults results;
+    results.horizon = horizon;
+    results.status.assign(jobs.size(), ForecastStatus::OK);
+    results.opens.assign(jobs.size() * horizon, nan);
+    results.highs.assign(results.opens.size(), nan);
+    results.lows.assign(results.opens.size(), nan);
+    results.closes.assign(results.opens.size(), nan);
+
+    const OHLCTable& table = DataBook::getYearlyCandles();
+    spread(jobs.size(), threadCount, [&](size_t j)
+    {
+        forecastJob(table, jobs[j], j, results);
+    });
+    return results;
+}
+
+BacktestScores BatchForecaster::backtest(const std::vector<Country>& countries, int firstYear, int lastYear, int windowYears,
+                                         int horizon, unsigned int threadCount)
+{
+    if (windowYears < 1 || horizon < 1 || lastYear - firstYear + 1 < windowYears)
+    {
+        throw std::runtime_error("No " + std::to_string(windowYears) + "-year reference window fits in " +
+                                 std::to_string(firstYear) + " to " + std::to_string(lastYear) + ".");
+    }
+
+    BacktestScores scores;
+    scores.horizon = horizon;
+    scores.windowYears = windowYears;
+    scores.countries = countries;
+    scores.counts.assign(countries.size() * horizon, 0);
+    for (int v = 0; v < 4; ++v)
+    {
+        scores.absoluteErrors[v].assign(scores.counts.size(), 0.0);
+        scores.squaredErrors[v].assign(scores.counts.size(), 0.0);
+    }
+
+    // Every country's candles are in the table before the workers read it
+    const OHLCTable* table = nullptr;
+    for (Country country : countries)
+    {
+        table = &DataBook::getYearlyCandles(country);
+    }
+    spread(countries.size(), threadCount, [&](size_t i)
+    {
+        backtestCountry(*table, firstYear, lastYear, i, scores);
+    });
+    return scores;
+}
+
+void BatchForecaster::forecastJob(const OHLCTable& table, const ForecastJob& job, size_t index, ForecastResults& results)
+{
+    if (job.referStartYear > job.referEndYear)
+    {
+        results.status[index] = ForecastStatus::BAD_RANGE;
+        return;
+    }
+
+    // Same reference as dataPredict: the window's candles, numbered from the start year in order,
+    // with the first one's open unknown
+    CandleRegression regression;
+    int candles = 0;
+    for (int year = job.referStartYear; year <= job.referEndYear; ++year)
+    {
+        if (!table.has(job.country, year))
+        {
+            continue;
+        }
+        const OHLC& candle = table.at(job.country, year);
+        double open = (year == job.referStartYear) ? std::numeric_limits<double>::quiet_NaN() : candle.open;
+        int x = job.referStartYear + candles++;
+
+        if (!std::isnan(open) && !std::isnan(candle.high) && !std::isnan(candle.low) && !std::isnan(candle.close))
+        {
+            regression.add(x, open, candle.high, candle.low, candle.close);
+        }
+    }
+
+    if (candles == 0)
+    {
+        results.status[index] = ForecastStatus::NO_REFERENCE;
+        return;
+    }
+    if (regression.count() == 0)
+    {
+        results.status[index] = ForecastStatus::NO_VALID_DATA;
+        return;
+    }
+
+    for (int k = 0; k < results.horizon; ++k)
+    {
+        OHLC predicted = regression.predict(job.referEndYear + 1 + k);
+        size_t slot = results.slot(index, k);
+        results.opens[slot] = predicted.open;
+        results.highs[slot] = predicted.high;
+        results.lows[slot] = predicted.low;
+        results.closes[slot] = predicted.close;
+    }
+}
+
+void BatchForecaster::backtestCountry(const OHLCTable& table, int firstYear, int lastYear, size_t index, BacktestScores& scores)
+{
+    // The window [start, end] slides one year at a time. As in forecastJob, a candle sits at
+    // x = start + its rank among the window's candles, and the start year's candle is left out
+    // of the fit for having no open.
+    Country country = scores.countries[index];
+    std::vector<OHLC> predicted(scores.horizon);
+    CandleRegression regression;
+    int candles = 0;
+    int start = firstYear;
+    int end = firstYear + scores.windowYears - 1;
+    for (int year = start; year <= end; ++year)
+    {
+        if (!table.has(country, year))
+            continue;
+        const OHLC& candle = table.at(country, year);
+        int x = start + candles++;
+        if (year != start && isComplete(candle))
+        {
+            regression.add(x, candle.open, candle.high, candle.low, candle.close);
+        }
+    }
+
+    while (true)
+    {
+        // Score the window's forecast against the years after it that have a whole candle; a line
+        // through fewer than two points has no slope, so such a window has no forecast to score
+        if (regression.count() >= 2)
+        {
+            regression.predict(end + 1, scores.horizon, predicted.data());
+            for (int k = 0; k < scores.horizon; ++k)
+            {
+                int year = end + 1 + k;
+                if (!table.has(country, year) || !isComplete(table.at(country, year)))
+                    continue;
+                const OHLC& actual = table.at(country, year);
+                const double errors[4] = {predicted[k].open - actual.open, predicted[k].high - actual.high,
+                                          predicted[k].low - actual.low, predicted[k].close - actual.close};
+                size_t slot = scores.slot(index, k);
+                ++scores.counts[slot];
+                for (int v = 0; v < 4; ++v)
+                {
+                    scores.absoluteErrors[v][slot] += std::fabs(errors[v]);
+                    scores.squaredErrors[v][slot] += errors[v] * errors[v];
+                }
+            }
+        }
+        if (end == lastYear)
+            break;
+
+        // Slide: the start year drops out; if it had a candle the others' ranks fall by one as the
+        // start rises by one, otherwise every x moves up a year
+        bool hadStart = table.has(country, start);
+        if (hadStart)
+            --candles;
+        regression.shift(hadStart ? 0 : 1);
+        ++start;
+        if (start <= end && table.has(country, start) && isComplete(table.at(country, start)))
+        {
+            const OHLC& first = table.at(country, start);
+            regression.remove(start, first.open, first.high, first.low, first.close);
+        }
+
+        // The year after the window comes in at the next rank
+        ++end;
+        if (table.has(country, end))
+        {
+            const OHLC& candle = table.at(country, end);
+            int x = start + candles++;
+            if (end != start && isComplete(candle))
+            {
+                regression.add(x, candle.open, candle.high, candle.low, candle.close);
+            }
+        }
+    }
+}
+
+bool BatchForecaster::isComplete(const OHLC& candle)
+{
+    return !std::isnan(candle.open) && !std::isnan(candle.high) && !std::isnan(candle.low) && !std::isnan(candle.close);
+}
+
+void BatchForecaster::spread(size_t jobCount, unsigned int threadCount, const std::function<void(size_t)>& work)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = static_cast<unsigned int>(std::min<size_t>(threadCount, jobCount));
+
+    // Workers take jobs off a shared counter and write only their own slots
+    std::atomic<size_t> nextJob{0};
+    auto worker = [&]()
+    {
+        for (size_t j = nextJob++; j < jobCount; j = nextJob++)
+        {
+            work(j);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < threadCount; ++t)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : workers)
+    {
+        thread.join();
+    }
+}
+
+double BacktestScores::mae(size_t slot, int value) const
+{
+    return counts[slot] > 0 ? absoluteErrors[value][slot] / counts[slot] : std::numeric_limits<double>::quiet_NaN();
+}
+
+double BacktestScores::rmse(size_t slot, int value) const
+{
+    return counts[slot] > 0 ? std::sqrt(squaredErrors[value][slot] / counts[slot]) : std::numeric_limits<double>::quiet_NaN();
+}
+
+std::vector<ForecastJob> BatchForecaster::allCountries(int referStartYear, int referEndYear)
+{
+    std::vector<ForecastJob> jobs;
+    for (int c = 0; c < COUNTRY_COUNT; ++c)
+    {
+        jobs.push_back(ForecastJob{static_cast<Country>(c), referStartYear, referEndYear});
+    }
+    return jobs;
+}
+
+const char* BatchForecaster::statusMessage(ForecastStatus status)
+{
+    switch (status)
+    {
+        case ForecastStatus::BAD_RANGE:
+            return "Start year cannot be greater than end year.";
+        case ForecastStatus::NO_REFERENCE:
+            return "Invalid reference range or empty reference data.";
+        case ForecastStatus::NO_VALID_DATA:
+            return "No valid data for regression after filtering out NaN values.";
+        case ForecastStatus::OK:
+        default:
+            return "";
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "DataBookEntry.h"
+#include "OHLCTable.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/** Least-squares lines of open, high, low and close against the year, all four
+ *  accumulated in one pass of sufficient statistics. Sums are taken in the
+ *  order the readings are added, so the fit matches a separate pass per line. */
+class CandleRegression
+{
+    public:
+        CandleRegression();
+
+        void add(int year, double open, double high, double low, double close);
+        /** take back a candle added at year */
+        void remove(int year, double open, double high, double low, double close);
+        /** move every candle added so far by years along the x axis, in O(1) */
+        void shift(int years);
+        int count() const { return n; }
+        /** the four fitted lines evaluated at year */
+        OHLC predict(int year) const;
+        /** predict(firstYear + i) for i < years into out, fitting the lines once */
+        void predict(int firstYear, int years, OHLC* out) const;
+
+    private:
+        int n;
+        double sumX;
+        double sumX2;
+        double sumY[4];  // open, high, low, close
+        double sumXY[4];
+};
+
+/** one forecast: a country and the years its regression is fitted on */
+class ForecastJob
+{
+    public:
+        Country country;
+        int referStartYear;
+        int referEndYear;
+};
+
+/** outcome of a forecast job */
+enum class ForecastStatus : uint8_t
+{
+    OK,
+    BAD_RANGE,     // start year after end year
+    NO_REFERENCE,  // no candles in the reference window
+    NO_VALID_DATA  // no candle with all four values to fit on
+};
+
+/** Forecasts of many jobs as struct-of-arrays.
+ *  Job j's forecast for referEndYear + 1 + k is at slot j * horizon + k;
+ *  slots of a job whose status is not OK hold NaN. */
+class ForecastResults
+{
+    public:
+        int horizon;
+        std::vector<ForecastStatus> status; // per job
+        std::vector<double> opens;          // per slot
+        std::vector<double> highs;
+        std::vector<double> lows;
+        std::vector<double> closes;
+
+        size_t slot(size_t job, int k) const { return job * horizon + k; }
+};
+
+/** Errors of backtested forecasts as struct-of-arrays, per country and horizon.
+ *  Country i's scores for forecasts k + 1 years ahead are at slot i * horizon + k. A slot
+ *  holds how many forecasts had an actual candle to be scored against and the sums of their
+ *  absolute and squared errors, for each of open, high, low and close (value 0-3). */
+class BacktestScores
+{
+    public:
+        int horizon;
+        int windowYears;
+        std::vector<Country> countries;
+        std::vector<uint32_t> counts;          // per slot
+        std::vector<double> absoluteErrors[4]; // [value] per slot
+        std::vector<double> squaredErrors[4];
+
+        size_t slot(size_t country, int k) const { return country * horizon + k; }
+        /** mean absolute and root mean squared error of a slot's value; NaN if nothing was scored */
+        double mae(size_t slot, int value) const;
+        double rmse(size_t slot, int value) const;
+};
+
+/** Forecasts straight from the yearly candle table, the jobs spread over a thread pool.
+ *  Each job gives the same numbers as Candlestick::dataPredict on its window. */
+class BatchForecaster
+{
+    public:
+        BatchForecaster();
+
+        /** forecast horizon years after each job's window on threadCount threads (0 = all hardware threads) */
+        static ForecastResults forecast(const std::vector<ForecastJob>& jobs, int horizon = 10, unsigned int threadCount = 0);
+
+        /** Score the forecast of every windowYears-long reference window within [firstYear, lastYear]
+         *  against the actual candles of the horizon years after it, countries spread over threadCount
+         *  threads (0 = all hardware threads). Each forecast is the one dataPredict makes for its
+         *  window, the regression sliding one year per window in O(1) instead of being refitted.
+         *  Windows with fewer than two candles to fit on are not scored.
+         *  Throws if no window fits in the range */
+        static BacktestScores backtest(const std::vector<Country>& countries, int firstYear, int lastYear, int windowYears,
+                                       int horizon = 10, unsigned int threadCount = 0);
+
+        /** one job per country for the same window */
+        static std::vector<ForecastJob> allCountries(int referStartYear, int referEndYear);
+
+        /** the error dataPredict raises for a status, empty for OK */
+        static const char* statusMessage(ForecastStatus status);
+
+    private:
+        static void forecastJob(const OHLCTable& table, const ForecastJob& job, size_t index, ForecastResults& results);
+        static void backtestCountry(const OHLCTable& table, int firstYear, int lastYear, size_t index, BacktestScores& scores);
+        /** a table candle with all four values, as the regression takes them */
+        static bool isComplete(const OHLC& candle);
+        /** run work(0) to work(jobCount - 1) on up to threadCount threads (0 = all hardware threads) */
+        static void spread(size_t jobCount, unsigned int threadCount, const std::function<void(size_t)>& work);
+};
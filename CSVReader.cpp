@@ -1,8 +1,39 @@
 #include "CSVReader.h"
+#include "MappedFile.h"
+#include "TimeIndex.h"
 #include <iostream>
-#include <fstream>
 #include <stdexcept>
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+
+namespace
+{
+    /** chunks smaller than this are not worth a thread of their own */
+    const size_t MIN_CHUNK_BYTES = 1 << 20;
+
+    /** only the first few bad rows of a load are printed, the rest are counted */
+    const size_t MAX_REPORTED_BAD_ROWS = 10;
+
+    /** serialises bad-data reports coming from parser threads */
+    std::mutex errorMutex;
+    std::atomic<size_t> reportedBadRows{0};
+
+    uint64_t nanosecondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+    }
+}
 
 CSVReader::CSVReader()
 {
@@ -10,43 +41,429 @@ CSVReader::CSVReader()
 
 std::vector<DataBookEntry> CSVReader::readCSV(const std::string& csvFilename)
 {
+    DataBookColumns columns;
+    readCSV(csvFilename, columns);
+
     std::vector<DataBookEntry> entries;
+    for (size_t row = 0; row < columns.rowCount(); ++row)
+    {
+        for (int c = 0; c < COUNTRY_COUNT; ++c)
+        {
+            double temp = columns.temperatures[c][row];
+            if (!std::isnan(temp)) // skip missing (NaN) readings, as empty cells were skipped before
+            {
+                entries.push_back(DataBookEntry{columns.hours[row], {temp}, static_cast<Country>(c)});
+            }
+        }
+    }
+
+    return entries;
+}
+
+size_t CSVReader::readCSV(const std::string& csvFilename, DataBookColumns& columns, unsigned int threadCount, size_t length)
+{
+    columns.clear();
+    reportedBadRows = 0;
+
+    std::unique_ptr<MappedFile> csvFile;
+    try
+    {
+        PhaseTimer timer{LoadPhase::Io};
+        csvFile = std::make_unique<MappedFile>(csvFilename);
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << "CSVReader::readCSV could not open file: " << csvFilename << std::endl;
+        throw std::runtime_error("Unable to open CSV file.");
+    }
+
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::string_view csvText = csvFile->view().substr(0, length);
+    size_t headerEnd = csvText.find('\n');
+    std::string_view csvBody = headerEnd == std::string_view::npos ? std::string_view{} : csvText.substr(headerEnd + 1);
+    std::vector<int> layout;
+    const std::vector<int>* remap = columnLayout(csvText.substr(0, headerEnd), layout) ? &layout : nullptr;
+
+    // Don't hand out chunks too small to pay for their thread
+    threadCount = static_cast<unsigned int>(std::min<size_t>(threadCount, csvBody.size() / MIN_CHUNK_BYTES + 1));
+
+    size_t rejected = (threadCount <= 1) ? parseCSV(csvText, columns, true, remap) : parseParallel(csvBody, columns, threadCount, remap);
+
+    // Queries rely on a sorted time axis; files written out of order get sorted once here
+    if (!columns.isSortedByTime())
+    {
+        PhaseTimer timer{LoadPhase::Build};
+        columns.sortByTime();
+    }
+
+    std::cerr << "CSVReader::readCSV read " << columns.rowCount() << " rows." << std::endl;
+    if (rejected > MAX_REPORTED_BAD_ROWS)
+    {
+        std::cerr << "CSVReader::readCSV found " << rejected << " bad rows, the first " << MAX_REPORTED_BAD_ROWS << " shown" << std::endl;
+    }
+    return csvText.size();
+}
+
+size_t CSVReader::readAppended(const std::string& csvFilename, size_t offset, DataBookColumns& columns)
+{
+    std::unique_ptr<MappedFile> csvFile;
+    try
+    {
+        PhaseTimer timer{LoadPhase::Io};
+        csvFile = std::make_unique<MappedFile>(csvFilename);
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << "CSVReader::readAppended could not open file: " << csvFilename << std::endl;
+        throw std::runtime_error("Unable to open CSV file.");
+    }
+
+    std::string_view csvText = csvFile->view();
+    if (csvText.size() < offset)
+    {
+        std::cerr << "CSVReader::readAppended " << csvFilename << " is shorter than the " << offset << " bytes already read" << std::endl;
+        throw std::runtime_error("CSV file was truncated.");
+    }
+
+    // Only whole lines: the writer may be half way through the last one
+    size_t lastNewline = csvText.rfind('\n');
+    if (lastNewline == std::string_view::npos || lastNewline < offset)
+    {
+        return offset;
+    }
+
+    // The header is read again for its layout, as the appended lines don't carry one
+    std::vector<int> layout;
+    const std::vector<int>* remap = columnLayout(csvText.substr(0, csvText.find('\n')), layout) ? &layout : nullptr;
+    size_t end = lastNewline + 1;
+    parseCSV(csvText.substr(offset, end - offset), columns, offset == 0, remap);
+    return end;
+}
+
+size_t CSVReader::completeLength(const std::string& csvFilename)
+{
+    std::unique_ptr<MappedFile> csvFile;
+    try
+    {
+        PhaseTimer timer{LoadPhase::Io};
+        csvFile = std::make_unique<MappedFile>(csvFilename);
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << "CSVReader::completeLength could not open file: " << csvFilename << std::endl;
+        throw std::runtime_error("Unable to open CSV file.");
+    }
+
+    size_t lastNewline = csvFile->view().rfind('\n');
+    return lastNewline == std::string_view::npos ? 0 : lastNewline + 1;
+}
+
+size_t CSVReader::streamCSV(const std::string& csvFilename, size_t memoryBudget,
+                            const std::function<void(const DataBookColumns&)>& onBlock, size_t& bytesInUse)
+{
+    reportedBadRows = 0;
+    bytesInUse = 0;
+
+    std::ifstream in{csvFilename, std::ios::binary};
+    std::string header, sample;
+    std::streampos bodyStart;
+    {
+        PhaseTimer timer{LoadPhase::Io};
+        if (in)
+        {
+            std::getline(in, header);
+            bodyStart = in.tellg();
+            std::getline(in, sample);
+            in.clear();
+            in.seekg(bodyStart);
+        }
+    }
+    if (!in)
+    {
+        std::cerr << "CSVReader::streamCSV could not open file: " << csvFilename << std::endl;
+        throw std::runtime_error("Unable to open CSV file.");
+    }
+
+    // A block of text costs its own bytes plus the columns its rows are parsed into
+    double columnBytesPerTextByte = static_cast<double>(sizeof(int64_t) + COUNTRY_COUNT * sizeof(double)) / (sample.size() + 1);
+    size_t blockBytes = static_cast<size_t>(memoryBudget / (1.0 + columnBytesPerTextByte));
+    if (blockBytes < MIN_BLOCK_BYTES)
+    {
+        std::cerr << "CSVReader::streamCSV a memory budget of " << memoryBudget << " bytes is too small for " << csvFilename << std::endl;
+        throw std::runtime_error("Memory budget too small to stream the CSV file.");
+    }
+
+    std::vector<int> layout;
+    const std::vector<int>* remap = columnLayout(header, layout) ? &layout : nullptr;
+
+    std::vector<char> buffer(blockBytes);
+    DataBookColumns block;
+    size_t held = 0;
+    size_t rows = 0;
+    size_t rejected = 0;
+    bool atEnd = false;
+    while (!atEnd)
+    {
+        {
+            PhaseTimer timer{LoadPhase::Io};
+            in.read(buffer.data() + held, static_cast<std::streamsize>(blockBytes - held));
+        }
+        held += static_cast<size_t>(in.gcount());
+        atEnd = !in;
+
+        // Whole lines only; the partial last one moves to the front of the buffer for the next read
+        std::string_view text{buffer.data(), held};
+        size_t end = atEnd ? held : text.rfind('\n') + 1;
+        if (end == 0)
+        {
+            std::cerr << "CSVReader::streamCSV a line of " << csvFilename << " is longer than the " << blockBytes << " byte block" << std::endl;
+            throw std::runtime_error("CSV line too long for the memory budget.");
+        }
+
+        block.clear();
+        rejected += parseCSV(text.substr(0, end), block, false, remap);
+        rows += block.rowCount();
+        bytesInUse = std::max(bytesInUse, buffer.size() + block.capacityBytes());
+        onBlock(block);
+
+        std::memmove(buffer.data(), buffer.data() + end, held - end);
+        held -= end;
+    }
+
+    std::cerr << "CSVReader::streamCSV read " << rows << " rows." << std::endl;
+    if (rejected > MAX_REPORTED_BAD_ROWS)
+    {
+        std::cerr << "CSVReader::streamCSV found " << rejected << " bad rows, the first " << MAX_REPORTED_BAD_ROWS << " shown" << std::endl;
+    }
+    return rows;
+}
+
+void CSVReader::readShards(const std::vector<std::string>& csvFiles, std::vector<DataBookColumns>& shards, unsigned int threadCount)
+{
+    shards.clear();
+    shards.resize(csvFiles.size());
+    reportedBadRows = 0;
 
-    std::ifstream csvFile{csvFilename};
-    std::string line;
-    bool isHeader = true; // Flag to skip the header row
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = static_cast<unsigned int>(std::min<size_t>(threadCount, csvFiles.size()));
 
-    if (csvFile.is_open())
+    // Workers take whole shards off a shared counter; a shard that cannot be read is reported after the join
+    std::vector<size_t> rejected(csvFiles.size(), 0);
+    std::vector<char> unreadable(csvFiles.size(), 0);
+    std::atomic<size_t> nextShard{0};
+    auto work = [&]()
     {
-        while (std::getline(csvFile, line))
+        for (size_t s = nextShard++; s < csvFiles.size(); s = nextShard++)
         {
-            if (isHeader)
+            std::unique_ptr<MappedFile> csvFile;
+            try
             {
-                isHeader = false; // Skip the first line
+                PhaseTimer timer{LoadPhase::Io};
+                csvFile = std::make_unique<MappedFile>(csvFiles[s]);
+            }
+            catch (const std::runtime_error& e)
+            {
+                unreadable[s] = 1;
                 continue;
             }
 
-            try
+            std::string_view csvText = csvFile->view();
+            std::vector<int> layout;
+            bool remapped = columnLayout(csvText.substr(0, csvText.find('\n')), layout);
+            rejected[s] = parseCSV(csvText, shards[s], true, remapped ? &layout : nullptr);
+            if (!shards[s].isSortedByTime())
             {
-                std::vector<DataBookEntry> rowEntries = stringsToDBE(tokenise(line, ','));
-                // Add all entries from this row to the main entries vector
-                entries.insert(entries.end(), rowEntries.begin(), rowEntries.end());
-                
+                PhaseTimer timer{LoadPhase::Build};
+                shards[s].sortByTime();
             }
-            catch (const std::exception& e)
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < threadCount; ++t)
+    {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    for (size_t s = 0; s < csvFiles.size(); ++s)
+    {
+        if (unreadable[s])
+        {
+            std::cerr << "CSVReader::readShards could not open file: " << csvFiles[s] << std::endl;
+            throw std::runtime_error("Unable to open CSV file.");
+        }
+        std::cerr << "CSVReader::readShards read " << shards[s].rowCount() << " rows from " << csvFiles[s] << std::endl;
+    }
+    size_t totalRejected = std::accumulate(rejected.begin(), rejected.end(), size_t{0});
+    if (totalRejected > MAX_REPORTED_BAD_ROWS)
+    {
+        std::cerr << "CSVReader::readShards found " << totalRejected << " bad rows, the first " << MAX_REPORTED_BAD_ROWS << " shown" << std::endl;
+    }
+}
+
+bool CSVReader::columnLayout(std::string_view header, std::vector<int>& layout)
+{
+    layout.clear();
+    if (!header.empty() && header.back() == '\r')
+    {
+        header.remove_suffix(1);
+    }
+
+    // Skip the timestamp column, then "<country code>_temperature" per column
+    size_t start = header.find(',');
+    bool standard = true;
+    bool named = false;
+    while (start != std::string_view::npos && layout.size() < static_cast<size_t>(COUNTRY_COUNT))
+    {
+        ++start;
+        size_t end = header.find(',', start);
+        std::string_view name = header.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+        start = end;
+
+        int country = -1;
+        size_t underscore = name.find('_');
+        if (underscore != std::string_view::npos && name.substr(underscore + 1) == "temperature")
+        {
+            Country parsed = DataBookEntry::stringToCountry(std::string(name.substr(0, underscore)));
+            if (parsed != Country::UNKNOWN)
             {
-                std::cerr << "CSVReader::readCSV bad data: " << e.what() << std::endl;
+                country = static_cast<int>(parsed);
             }
         }
+        standard = standard && country == static_cast<int>(layout.size());
+        named = named || country >= 0;
+        layout.push_back(country);
     }
-    else
+    return named && !(standard && layout.size() == static_cast<size_t>(COUNTRY_COUNT));
+}
+
+size_t CSVReader::parseCSV(std::string_view csvText, DataBookColumns& columns, bool hasHeader, const std::vector<int>* layout)
+{
+    PhaseTimer timer{LoadPhase::Parse};
+    ParseTally tally{};
+    size_t badRows = 0;
+    size_t pos = 0;
+
+    // Skip the header row
+    if (hasHeader)
     {
-        std::cerr << "CSVReader::readCSV could not open file: " << csvFilename << std::endl;
-        throw std::runtime_error("Unable to open CSV file.");
+        size_t headerEnd = csvText.find('\n');
+        pos = (headerEnd == std::string_view::npos) ? csvText.size() : headerEnd + 1;
     }
 
-    std::cout << "CSVReader::readCSV read " << entries.size() << " entries." << std::endl;
-    return entries;
+    // Size the columns up front from the length of the first data line
+    size_t sampleEnd = csvText.find('\n', pos);
+    if (sampleEnd != std::string_view::npos && sampleEnd > pos)
+    {
+        columns.reserve(columns.rowCount() + (csvText.size() - pos) / (sampleEnd - pos + 1) + 1);
+    }
+
+    while (pos < csvText.size())
+    {
+        size_t end = csvText.find('\n', pos);
+        if (end == std::string_view::npos)
+            end = csvText.size();
+
+        std::string_view line = csvText.substr(pos, end - pos);
+        pos = end + 1;
+
+        uint64_t blanked = tally.rejected[static_cast<int>(RejectReason::BadNumber)];
+        if (!parseRow(line, columns, tally, layout) || tally.rejected[static_cast<int>(RejectReason::BadNumber)] != blanked)
+        {
+            ++badRows;
+            if (reportedBadRows++ < MAX_REPORTED_BAD_ROWS)
+            {
+                std::lock_guard<std::mutex> lock{errorMutex};
+                std::cerr << "CSVReader::readCSV bad data: " << line << std::endl;
+            }
+        }
+    }
+
+    // One set of atomic adds per call; the sampled split of the row time is scaled to every line
+    for (int r = 0; r < REJECT_REASON_COUNT; ++r)
+    {
+        Metrics::addRejected(static_cast<RejectReason>(r), tally.rejected[r]);
+    }
+    Metrics::addParsed(csvText.size(), tally.rows, tally.cells);
+    if (tally.sampledLines > 0)
+    {
+        Metrics::addTime(LoadPhase::Tokenise, tally.tokeniseNanoseconds * tally.lines / tally.sampledLines);
+        Metrics::addTime(LoadPhase::NumberParse, tally.numberNanoseconds * tally.lines / tally.sampledLines);
+    }
+    return badRows;
+}
+
+size_t CSVReader::parseParallel(std::string_view csvBody, DataBookColumns& columns, unsigned int threadCount,
+                                const std::vector<int>* layout)
+{
+    // Split at newline boundaries into roughly equal chunks
+    std::vector<std::string_view> chunks;
+    size_t chunkSize = csvBody.size() / threadCount + 1;
+    size_t start = 0;
+    while (start < csvBody.size())
+    {
+        size_t end = csvBody.find('\n', std::min(start + chunkSize, csvBody.size() - 1));
+        end = (end == std::string_view::npos) ? csvBody.size() : end + 1;
+        chunks.push_back(csvBody.substr(start, end - start));
+        start = end;
+    }
+
+    // Each worker parses its chunk into its own column buffers
+    std::vector<DataBookColumns> parts(chunks.size());
+    std::vector<size_t> rejected(chunks.size(), 0);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        workers.emplace_back([&chunks, &parts, &rejected, layout, i]()
+        {
+            rejected[i] = parseCSV(chunks[i], parts[i], false, layout);
+        });
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    workers.clear();
+
+    // Stitch the chunks together in file order, each worker copying its own part
+    PhaseTimer timer{LoadPhase::Build};
+    std::vector<size_t> offsets(parts.size() + 1, 0);
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        offsets[i + 1] = offsets[i] + parts[i].rowCount();
+    }
+    columns.resize(offsets.back());
+
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        workers.emplace_back([&columns, &parts, &offsets, i]()
+        {
+            DataBookColumns& part = parts[i];
+            std::copy(part.hours.begin(), part.hours.end(), columns.hours.begin() + offsets[i]);
+            for (int c = 0; c < COUNTRY_COUNT; ++c)
+            {
+                std::copy(part.temperatures[c].begin(), part.temperatures[c].end(), columns.temperatures[c].begin() + offsets[i]);
+            }
+            part.clear();
+        });
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    return std::accumulate(rejected.begin(), rejected.end(), size_t{0});
 }
 
 std::vector<std::string> CSVReader::tokenise(const std::string& csvLine, char separator)
@@ -66,78 +483,164 @@ std::vector<std::string> CSVReader::tokenise(const std::string& csvLine, char se
     return tokens;
 }
 
-std::vector<DataBookEntry> CSVReader::stringsToDBE(const std::vector<std::string>& tokens)
+void CSVReader::tokenise(std::string_view csvLine, char separator, std::vector<std::string_view>& tokens)
 {
-    if (tokens.size() < 2) // Minimum: timestamp + at least one temperature
+    tokens.clear();
+    size_t start = 0;
+    size_t end = csvLine.find(separator);
+
+    while (end != std::string_view::npos)
     {
-        std::cerr << "CSVReader::stringsToDBE: Bad line with insufficient tokens." << std::endl;
-        throw std::invalid_argument("Invalid number of tokens.");
+        tokens.push_back(csvLine.substr(start, end - start));
+        start = end + 1;
+        end = csvLine.find(separator, start);
     }
+    tokens.push_back(csvLine.substr(start));
+}
+
+bool CSVReader::parseTemperature(std::string_view token, double& value)
+{
+    // Exact powers of ten, the fast path divides by one of these
+    static const double powersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
 
-    std::vector<DataBookEntry> entries; // Store all entries for this row
+    const char* p = token.data();
+    const char* end = p + token.size();
 
-    try
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+'))
     {
-        // Parse timestamp (first token)
-        std::string timestamp = tokens[0];
+        negative = (*p == '-');
+        ++p;
+    }
 
-        // Iterate over each temperature column and assign it to the correct country
-        for (size_t i = 1; i < tokens.size(); ++i)
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int fractionDigits = 0;
+    while (p != end && *p >= '0' && *p <= '9')
+    {
+        mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+        ++digits;
+        ++p;
+    }
+    if (p != end && *p == '.')
+    {
+        ++p;
+        while (p != end && *p >= '0' && *p <= '9')
         {
-            if (tokens[i].empty())
-                continue; // Skip empty tokens
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+            ++digits;
+            ++fractionDigits;
+            ++p;
+        }
+    }
 
-            // Attempt to convert the temperature value
-            double temp = std::stod(tokens[i]);
+    // Plain decimals like "-3.125": mantissa and divisor are both exact doubles,
+    // so one division gives the same correctly rounded result as strtod
+    if (p == end && digits > 0 && digits <= 15)
+    {
+        value = static_cast<double>(mantissa) / powersOfTen[fractionDigits];
+        if (negative)
+            value = -value;
+        return true;
+    }
 
-            // Match the column index to the country
-            Country country;
-            switch (i)
-            {
-                case 1:  country = Country::AT; break;
-                case 2:  country = Country::BE; break;
-                case 3:  country = Country::BG; break;
-                case 4:  country = Country::CH; break;
-                case 5:  country = Country::CZ; break;
-                case 6:  country = Country::DE; break;
-                case 7:  country = Country::DK; break;
-                case 8:  country = Country::EE; break;
-                case 9:  country = Country::ES; break;
-                case 10: country = Country::FI; break;
-                case 11: country = Country::FR; break;
-                case 12: country = Country::GB; break;
-                case 13: country = Country::GR; break;
-                case 14: country = Country::HR; break;
-                case 15: country = Country::HU; break;
-                case 16: country = Country::IE; break;
-                case 17: country = Country::IT; break;
-                case 18: country = Country::LT; break;
-                case 19: country = Country::LU; break;
-                case 20: country = Country::LV; break;
-                case 21: country = Country::NL; break;
-                case 22: country = Country::NO; break;
-                case 23: country = Country::PL; break;
-                case 24: country = Country::PT; break;
-                case 25: country = Country::RO; break;
-                case 26: country = Country::SE; break;
-                case 27: country = Country::SI; break;
-                case 28: country = Country::SK; break;
-                default: country = Country::UNKNOWN; break;
-            }
+    // Anything else (exponents, very long numbers) goes through strtod on a stack copy
+    char buffer[64];
+    if (token.empty() || token.size() >= sizeof(buffer))
+    {
+        return false;
+    }
+    std::memcpy(buffer, token.data(), token.size());
+    buffer[token.size()] = '\0';
 
-            if (country != Country::UNKNOWN)
-            {
-                // Create a DataBookEntry for this country and temperature
-                DataBookEntry dbe{timestamp, {temp}, country};
-                entries.push_back(dbe); // Add to the vector of entries
-            }
+    char* parsedEnd = nullptr;
+    value = std::strtod(buffer, &parsedEnd);
+    return parsedEnd == buffer + token.size();
+}
+
+bool CSVReader::parseRow(std::string_view line, DataBookColumns& columns, ParseTally& tally, const std::vector<int>* layout)
+{
+    // Every PARSE_SAMPLE_EVERY-th line is timed, split into tokenising and number parsing
+    bool timed = (tally.lines++ % Metrics::PARSE_SAMPLE_EVERY) == 0;
+    std::chrono::steady_clock::time_point started;
+    if (timed)
+    {
+        started = std::chrono::steady_clock::now();
+    }
+
+    if (!line.empty() && line.back() == '\r')
+    {
+        line.remove_suffix(1);
+    }
+
+    // Minimum: timestamp + at least one temperature
+    size_t comma = line.find(',');
+    if (comma == std::string_view::npos)
+    {
+        ++tally.rejected[static_cast<int>(RejectReason::MissingCells)];
+        return false;
+    }
+
+    // Parsed once into an epoch hour; nothing downstream looks at the text again
+    int64_t hour;
+    if (!TimeIndex::parseEpochHour(line.substr(0, comma), hour))
+    {
+        ++tally.rejected[static_cast<int>(RejectReason::BadTimestamp)];
+        return false;
+    }
+
+    // Column i of the file holds Country(i - 1) unless a layout says otherwise; cells past the last country are ignored
+    std::string_view cells[COUNTRY_COUNT];
+    int cellLimit = layout ? static_cast<int>(layout->size()) : COUNTRY_COUNT;
+    int cellCount = 0;
+    size_t start = comma + 1;
+    while (cellCount < cellLimit)
+    {
+        size_t end = line.find(',', start);
+        cells[cellCount++] = line.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+        if (end == std::string_view::npos)
+            break;
+        start = end + 1;
+    }
+
+    std::chrono::steady_clock::time_point tokenised;
+    if (timed)
+    {
+        tokenised = std::chrono::steady_clock::now();
+    }
+
+    // Empty cells stay NaN
+    double row[COUNTRY_COUNT];
+    std::fill(row, row + COUNTRY_COUNT, std::numeric_limits<double>::quiet_NaN());
+    uint64_t readings = 0;
+    for (int c = 0; c < cellCount; ++c)
+    {
+        int country = layout ? (*layout)[c] : c;
+        if (cells[c].empty() || country < 0)
+            continue;
+        // A malformed reading blanks its own cell and keeps the row, as a column read by CSVRowIndex does
+        if (!parseTemperature(cells[c], row[country]))
+        {
+            row[country] = std::numeric_limits<double>::quiet_NaN();
+            ++tally.rejected[static_cast<int>(RejectReason::BadNumber)];
+            continue;
         }
+        ++readings;
     }
-    catch (const std::exception& e)
+
+    if (timed)
     {
-        std::cerr << "CSVReader::stringsToDBE: Failed to parse tokens: " << e.what() << std::endl;
-        throw;
+        std::chrono::steady_clock::time_point parsed = std::chrono::steady_clock::now();
+        ++tally.sampledLines;
+        tally.tokeniseNanoseconds += nanosecondsBetween(started, tokenised);
+        tally.numberNanoseconds += nanosecondsBetween(tokenised, parsed);
     }
 
-    return entries; // Return all entries for this row
+    columns.addRow(hour, row);
+    ++tally.rows;
+    tally.cells += readings;
+    return true;
 }
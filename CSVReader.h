@@ -1,17 +1,85 @@
 #pragma once
 
 #include "DataBookEntry.h"
+#include "DataBookColumns.h"
+#include "Metrics.h"
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <string>
+#include <string_view>
 
 class CSVReader
 {
     public:
         CSVReader();
 
+        /** compatibility wrapper: one DataBookEntry per non-empty temperature cell */
         static std::vector<DataBookEntry> readCSV(const std::string& csvFile);
+        /** memory-map a csv file and parse it in place straight into columnar storage.
+         *  Its header decides which country each column holds (see columnLayout), as in every reader here.
+         *  threadCount > 1 parses newline-aligned chunks in parallel, 0 uses all hardware threads.
+         *  Only the first length bytes are read when the file is longer.
+         *  returns the number of bytes parsed */
+        static size_t readCSV(const std::string& csvFile, DataBookColumns& columns, unsigned int threadCount = 1,
+                              size_t length = std::string_view::npos);
+        /** parse the complete lines appended to a csv file after byte offset and add them to columns,
+         *  leaving a partly written last line for the next call. returns the offset parsed up to.
+         *  Throws if the file is now shorter than offset (truncated or replaced) */
+        static size_t readAppended(const std::string& csvFile, size_t offset, DataBookColumns& columns);
+        /** bytes of a csv up to and including its last newline, leaving out a line still being written.
+         *  Throws if the file cannot be opened */
+        static size_t completeLength(const std::string& csvFile);
+        /** read a csv of any size block by block without keeping its rows: each block's rows are
+         *  handed to onBlock, then dropped. Blocks are sized so the read buffer and the block's
+         *  columns together stay within memoryBudget bytes; bytesInUse returns the most they held.
+         *  Throws if the file cannot be read or a line does not fit in a block. returns the rows read */
+        static size_t streamCSV(const std::string& csvFile, size_t memoryBudget,
+                                const std::function<void(const DataBookColumns&)>& onBlock, size_t& bytesInUse);
+        /** read several csv shards side by side on threadCount threads (0 = all hardware threads),
+         *  each into its own time-sorted columns. Every shard's header decides which country its
+         *  columns hold, so shards may carry different countries. Throws if a shard cannot be read */
+        static void readShards(const std::vector<std::string>& csvFiles, std::vector<DataBookColumns>& shards, unsigned int threadCount);
+        /** parse csv text and append its rows to columns, skipping the first line if hasHeader.
+         *  Data column i goes to Country(i), or to Country((*layout)[i]) when a layout is given.
+         *  Rows, cells, rejects and parse time are added to Metrics. returns the number of bad rows:
+         *  rejected ones and ones with a malformed reading left blank */
+        static size_t parseCSV(std::string_view csvText, DataBookColumns& columns, bool hasHeader = true,
+                               const std::vector<int>* layout = nullptr);
+        /** countries of a header's data columns: "AT_temperature" is Country::AT, anything else -1.
+         *  returns false when column i holds Country(i) and no layout is needed: the header is the
+         *  standard one, or names no country at all and is read in enum order as it always was */
+        static bool columnLayout(std::string_view header, std::vector<int>& layout);
+
         static std::vector<std::string> tokenise(const std::string& csvLine, char separator);
+        /** split a line without copying, tokens point into csvLine */
+        static void tokenise(std::string_view csvLine, char separator, std::vector<std::string_view>& tokens);
+
+        /** parse a decimal number without allocating; returns false on malformed input */
+        static bool parseTemperature(std::string_view token, double& value);
+
+        /** smallest block streamCSV reads at once */
+        static const size_t MIN_BLOCK_BYTES = 64u << 10;
 
     private:
-        static std::vector<DataBookEntry> stringsToDBE(const std::vector<std::string>& tokens);
+        /** what one parseCSV call saw, added to Metrics when it is done */
+        class ParseTally
+        {
+            public:
+                uint64_t lines;
+                uint64_t rows;
+                uint64_t cells;
+                uint64_t rejected[REJECT_REASON_COUNT];
+                uint64_t sampledLines;
+                uint64_t tokeniseNanoseconds;
+                uint64_t numberNanoseconds;
+        };
+
+        /** parse the body (header removed) on threadCount workers and stitch the chunks in file order.
+         *  returns the number of bad rows */
+        static size_t parseParallel(std::string_view csvBody, DataBookColumns& columns, unsigned int threadCount,
+                                    const std::vector<int>* layout);
+        /** parse one data line into a row of columns; returns false and counts why if the line is rejected.
+         *  A malformed reading is counted as BadNumber and left blank, the rest of the row is kept */
+        static bool parseRow(std::string_view line, DataBookColumns& columns, ParseTally& tally, const std::vector<int>* layout);
 };
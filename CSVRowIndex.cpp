@@ -0,0 +1,188 @@
+#include "CSVRowIndex.h"
+#include "CSVReader.h"
+#include "MappedFile.h"
+#include "Metrics.h"
+#include "TimeIndex.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace
+{
+    /** only the first few bad rows are printed, the rest are counted */
+    const size_t MAX_REPORTED_BAD_ROWS = 10;
+}
+
+CSVRowIndex::CSVRowIndex()
+{
+}
+
+size_t CSVRowIndex::build(const std::string& csvFile, DataBookColumns& columns, size_t length)
+{
+    clear();
+    columns.clear();
+    try
+    {
+        PhaseTimer timer{LoadPhase::Io};
+        file = std::make_shared<MappedFile>(csvFile);
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << "CSVRowIndex::build could not open file: " << csvFile << std::endl;
+        throw std::runtime_error("Unable to open CSV file.");
+    }
+
+    PhaseTimer timer{LoadPhase::Parse};
+    text = file->view().substr(0, length);
+    size_t headerEnd = text.find('\n');
+    if (!CSVReader::columnLayout(text.substr(0, headerEnd), layout))
+    {
+        layout.clear();
+    }
+    size_t pos = (headerEnd == std::string_view::npos) ? text.size() : headerEnd + 1;
+
+    // Only the timestamp of a row is parsed; the readings are found again from its first cell
+    std::vector<int64_t>& hours = columns.hours;
+    uint64_t rejected[REJECT_REASON_COUNT] = {};
+    size_t sampleEnd = text.find('\n', pos);
+    if (sampleEnd != std::string_view::npos && sampleEnd > pos)
+    {
+        size_t expected = (text.size() - pos) / (sampleEnd - pos + 1) + 1;
+        hours.reserve(expected);
+        rowStarts.reserve(expected);
+    }
+    while (pos < text.size())
+    {
+        size_t end = text.find('\n', pos);
+        if (end == std::string_view::npos)
+            end = text.size();
+        std::string_view line = text.substr(pos, end - pos);
+
+        int64_t hour;
+        size_t comma = line.find(',');
+        RejectReason reason = RejectReason::MissingCells;
+        bool good = comma != std::string_view::npos;
+        if (good)
+        {
+            reason = RejectReason::BadTimestamp;
+            good = TimeIndex::parseEpochHour(line.substr(0, comma), hour);
+        }
+        if (good)
+        {
+            hours.push_back(hour);
+            rowStarts.push_back(pos + comma + 1);
+        }
+        else if (rejected[static_cast<int>(reason)]++ < MAX_REPORTED_BAD_ROWS)
+        {
+            std::cerr << "CSVRowIndex::build bad data: " << line << std::endl;
+        }
+        pos = end + 1;
+    }
+
+    // Rows out of time order are put in order once here, stably like DataBookColumns::sortByTime
+    if (!std::is_sorted(hours.begin(), hours.end()))
+    {
+        std::vector<size_t> order(hours.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&hours](size_t a, size_t b) { return hours[a] < hours[b]; });
+
+        std::vector<int64_t> sortedHours(order.size());
+        std::vector<uint64_t> sortedStarts(order.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            sortedHours[i] = hours[order[i]];
+            sortedStarts[i] = rowStarts[order[i]];
+        }
+        hours.swap(sortedHours);
+        rowStarts.swap(sortedStarts);
+    }
+
+    for (int r = 0; r < REJECT_REASON_COUNT; ++r)
+    {
+        Metrics::addRejected(static_cast<RejectReason>(r), rejected[r]);
+    }
+    Metrics::addParsed(text.size(), hours.size(), 0);
+    std::cerr << "CSVRowIndex::build indexed " << hours.size() << " rows." << std::endl;
+    return text.size();
+}
+
+std::vector<double> CSVRowIndex::readColumn(Country country) const
+{
+    PhaseTimer timer{LoadPhase::Parse};
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    std::vector<double> readings(rowStarts.size(), nan);
+    // Data cell i holds Country(i) unless the header says otherwise, as in CSVReader::readCSV;
+    // a country named twice takes its last column, as a parse row by row would
+    int cell = static_cast<int>(country);
+    if (cell < 0 || cell >= COUNTRY_COUNT)
+    {
+        return readings;
+    }
+    if (!layout.empty())
+    {
+        std::vector<int>::const_reverse_iterator named = std::find(layout.rbegin(), layout.rend(), cell);
+        if (named == layout.rend())
+        {
+            return readings;
+        }
+        cell = static_cast<int>(layout.rend() - named) - 1;
+    }
+
+    uint64_t cells = 0;
+    uint64_t malformed = 0;
+    const char* end = text.data() + text.size();
+    for (size_t row = 0; row < rowStarts.size(); ++row)
+    {
+        // Skip to the country's cell; a row that ends first has no reading
+        const char* p = text.data() + rowStarts[row];
+        for (int skipped = 0; skipped < cell && p != end && *p != '\n'; ++p)
+        {
+            if (*p == ',')
+                ++skipped;
+        }
+        if (p != end && p > text.data() + rowStarts[row] && p[-1] != ',')
+            continue;
+
+        const char* cellEnd = p;
+        while (cellEnd != end && *cellEnd != ',' && *cellEnd != '\n' && *cellEnd != '\r')
+        {
+            ++cellEnd;
+        }
+        if (cellEnd == p)
+            continue;
+
+        if (CSVReader::parseTemperature(std::string_view{p, static_cast<size_t>(cellEnd - p)}, readings[row]))
+        {
+            ++cells;
+        }
+        else
+        {
+            readings[row] = nan;
+            ++malformed;
+        }
+    }
+
+    Metrics::addParsed(0, 0, cells);
+    Metrics::addRejected(RejectReason::BadNumber, malformed);
+    if (malformed > 0)
+    {
+        std::cerr << "CSVRowIndex::readColumn " << malformed << " malformed " << DataBookEntry::countryToString(country)
+                  << " readings left blank" << std::endl;
+    }
+    return readings;
+}
+
+void CSVRowIndex::clear()
+{
+    std::vector<uint64_t>().swap(rowStarts);
+    std::vector<int>().swap(layout);
+    text = std::string_view{};
+    file.reset();
+}
+
+bool CSVRowIndex::isBuilt() const
+{
+    return file != nullptr;
+}
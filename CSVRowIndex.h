@@ -0,0 +1,41 @@
+#pragma once
+
+#include "DataBookColumns.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class MappedFile;
+
+/** Where every row of a csv starts, so one country's readings can be parsed without the others.
+ *
+ *  build() maps the file and parses the timestamps only; the readings stay text in
+ *  the mapping until readColumn() asks for a country, which costs one pass over
+ *  that country's cells. Rows are held in time order, as DataBookColumns wants them.
+ *  A malformed reading blanks its own cell, as in a full parse, so both give the same columns. */
+class CSVRowIndex
+{
+    public:
+        CSVRowIndex();
+
+        /** map csvFile and index its rows into columns.hours, leaving every country's column
+         *  out. Only the first length bytes are read when the file is longer.
+         *  Throws if the file cannot be opened. returns the number of bytes indexed */
+        size_t build(const std::string& csvFile, DataBookColumns& columns, size_t length = std::string_view::npos);
+        /** one country's reading of every indexed row, NaN where it has none */
+        std::vector<double> readColumn(Country country) const;
+        /** forget the rows and unmap the file */
+        void clear();
+        bool isBuilt() const;
+
+    private:
+        std::shared_ptr<const MappedFile> file;
+        std::string_view text;
+        /** offset in text of each row's first reading, in time order */
+        std::vector<uint64_t> rowStarts;
+        /** [cell] = country of each data column, from the header (see CSVReader::columnLayout);
+         *  empty when cell i holds Country(i) */
+        std::vector<int> layout;
+};
@@ -0,0 +1,416 @@
+#include "CandlePyramid.h"
+#include "TimeIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+namespace
+{
+    int64_t floorDiv(int64_t a, int64_t b)
+    {
+        return (a >= 0) ? a / b : -((-a + b - 1) / b);
+    }
+
+    /** 1970-01-01 was a Thursday; shifting by 3 days makes weeks start on Monday */
+    int64_t weekOfDay(int64_t day)
+    {
+        return floorDiv(day + 3, 7);
+    }
+
+    int64_t monthOfDay(int64_t day)
+    {
+        int year, month, dayOfMonth;
+        TimeIndex::civilFromDays(day, year, month, dayOfMonth);
+        return static_cast<int64_t>(year) * 12 + (month - 1);
+    }
+
+    int64_t yearOfMonth(int64_t month)
+    {
+        return floorDiv(month, 12);
+    }
+
+    size_t levelIndex(Granularity granularity)
+    {
+        return static_cast<size_t>(granularity) - 1; // Hour has no stored level
+    }
+}
+
+CandlePyramid::CandlePyramid()
+: source(nullptr)
+{
+}
+
+void CandlePyramid::build(const DataBookColumns& columns)
+{
+    clear();
+    source = &columns;
+    addRows(columns, 0);
+}
+
+void CandlePyramid::extend(const DataBookColumns& columns, size_t firstNewRow)
+{
+    if (!isBuilt() || firstNewRow == 0 || dayStarts.empty() || firstNewRow != dayStarts.back())
+    {
+        build(columns);
+        return;
+    }
+    source = &columns;
+    addRows(columns, firstNewRow);
+}
+
+void CandlePyramid::addRows(const DataBookColumns& columns, size_t firstRow)
+{
+    // Where each day starts
+    const size_t rows = columns.rowCount();
+    Level& days = levels[levelIndex(Granularity::Day)];
+    if (!dayStarts.empty())
+    {
+        dayStarts.pop_back(); // the trailing row count
+    }
+
+    size_t firstDay = days.periods.size();
+    for (size_t row = firstRow; row < rows; ++row)
+    {
+        int64_t dayOrdinal = floorDiv(columns.hours[row], 24);
+        if (days.periods.empty() || days.periods.back() != dayOrdinal)
+        {
+            days.periods.push_back(dayOrdinal);
+            dayStarts.push_back(row);
+        }
+        else if (row == firstRow)
+        {
+            firstDay = days.periods.size() - 1; // new rows complete the last day
+        }
+    }
+    dayStarts.push_back(rows);
+
+    // Aggregates of the new days, one contiguous scan per country column
+    days.countries.resize(COUNTRY_COUNT);
+    for (int c = 0; c < COUNTRY_COUNT; ++c)
+    {
+        aggregateDays(columns, c, firstDay);
+    }
+
+    // Coarser levels are merged again from the level below, from the first period touched
+    deriveLevel(days, levels[levelIndex(Granularity::Week)], &weekOfDay, firstDay);
+    size_t firstMonth = deriveLevel(days, levels[levelIndex(Granularity::Month)], &monthOfDay, firstDay);
+    deriveLevel(levels[levelIndex(Granularity::Month)], levels[levelIndex(Granularity::Year)], &yearOfMonth, firstMonth);
+}
+
+void CandlePyramid::aggregateDays(const DataBookColumns& columns, int c, size_t firstDay)
+{
+    const Level& days = levels[levelIndex(Granularity::Day)];
+    std::vector<Aggregate>& out = levels[levelIndex(Granularity::Day)].countries[c];
+    const Aggregate empty{std::numeric_limits<double>::lowest(), std::numeric_limits<double>::max(), 0.0, 0};
+    out.resize(days.periods.size());
+    if (!columns.hasColumn(static_cast<Country>(c)))
+    {
+        std::fill(out.begin() + firstDay, out.end(), empty);
+        return;
+    }
+
+    // Compressed readings are unpacked first, from the first day on
+    const size_t rows = columns.rowCount();
+    std::vector<double> unpacked;
+    const double* column = columns.column(static_cast<Country>(c));
+    size_t columnStart = 0; // row held at column[0]
+    if (!column)
+    {
+        columnStart = dayStarts[firstDay];
+        unpacked.resize(rows - columnStart);
+        columns.decode(static_cast<Country>(c), columnStart, rows, unpacked.data());
+        column = unpacked.data();
+    }
+    for (size_t d = firstDay; d < days.periods.size(); ++d)
+    {
+        Aggregate a = empty;
+        for (size_t row = dayStarts[d]; row < dayStarts[d + 1]; ++row)
+        {
+            double t = column[row - columnStart];
+            if (std::isnan(t))
+                continue;
+            a.high = std::max(a.high, t);
+            a.low = std::min(a.low, t);
+            a.sum += t;
+            ++a.count;
+        }
+        out[d] = a;
+    }
+}
+
+void CandlePyramid::addCountry(const DataBookColumns& columns, Country country)
+{
+    int c = static_cast<int>(country);
+    if (!isBuilt() || c < 0 || c >= COUNTRY_COUNT || dayStarts.empty())
+    {
+        return;
+    }
+
+    // Periods are already laid out by the build; only this country's aggregates are filled in
+    aggregateDays(columns, c, 0);
+    deriveCountry(levels[levelIndex(Granularity::Day)], levels[levelIndex(Granularity::Week)], &weekOfDay, c);
+    deriveCountry(levels[levelIndex(Granularity::Day)], levels[levelIndex(Granularity::Month)], &monthOfDay, c);
+    deriveCountry(levels[levelIndex(Granularity::Month)], levels[levelIndex(Granularity::Year)], &yearOfMonth, c);
+}
+
+void CandlePyramid::clear()
+{
+    source = nullptr;
+    dayStarts.clear();
+    for (Level& level : levels)
+    {
+        level.periods.clear();
+        level.countries.clear();
+    }
+}
+
+bool CandlePyramid::isBuilt() const
+{
+    return source != nullptr;
+}
+
+size_t CandlePyramid::deriveLevel(const Level& child, Level& parent, int64_t (*parentOf)(int64_t), size_t firstChild)
+{
+    if (firstChild >= child.periods.size())
+    {
+        return parent.periods.size();
+    }
+
+    // Child periods are sorted and parentOf is monotonic, so parents are runs of children.
+    // Rewind to the start of the run holding firstChild and drop that parent onwards
+    int64_t firstPeriod = parentOf(child.periods[firstChild]);
+    while (firstChild > 0 && parentOf(child.periods[firstChild - 1]) == firstPeriod)
+    {
+        --firstChild;
+    }
+    size_t firstParent = std::lower_bound(parent.periods.begin(), parent.periods.end(), firstPeriod) - parent.periods.begin();
+    parent.periods.resize(firstParent);
+
+    std::vector<size_t> runStarts;
+    for (size_t i = firstChild; i < child.periods.size(); ++i)
+    {
+        int64_t p = parentOf(child.periods[i]);
+        if (parent.periods.empty() || parent.periods.back() != p)
+        {
+            parent.periods.push_back(p);
+            runStarts.push_back(i);
+        }
+    }
+    runStarts.push_back(child.periods.size());
+
+    parent.countries.resize(child.countries.size());
+    for (size_t c = 0; c < child.countries.size(); ++c)
+    {
+        std::vector<Aggregate>& out = parent.countries[c];
+        out.resize(firstParent);
+        for (size_t r = 0; r + 1 < runStarts.size(); ++r)
+        {
+            Aggregate a{std::numeric_limits<double>::lowest(), std::numeric_limits<double>::max(), 0.0, 0};
+            for (size_t i = runStarts[r]; i < runStarts[r + 1]; ++i)
+            {
+                merge(a, child.countries[c][i]);
+            }
+            out.push_back(a);
+        }
+    }
+    return firstParent;
+}
+
+void CandlePyramid::deriveCountry(const Level& child, Level& parent, int64_t (*parentOf)(int64_t), int c)
+{
+    std::vector<Aggregate>& out = parent.countries[c];
+    std::fill(out.begin(), out.end(), Aggregate{std::numeric_limits<double>::lowest(), std::numeric_limits<double>::max(), 0.0, 0});
+
+    // Parents are runs of consecutive children, so one forward walk pairs them up
+    size_t p = 0;
+    for (size_t i = 0; i < child.periods.size(); ++i)
+    {
+        int64_t period = parentOf(child.periods[i]);
+        while (parent.periods[p] != period)
+        {
+            ++p;
+        }
+        merge(out[p], child.countries[c][i]);
+    }
+}
+
+void CandlePyramid::merge(Aggregate& into, const Aggregate& from)
+{
+    if (from.count == 0)
+        return;
+    into.high = std::max(into.high, from.high);
+    into.low = std::min(into.low, from.low);
+    into.sum += from.sum;
+    into.count += from.count;
+}
+
+CandleSeries CandlePyramid::query(Country country, Granularity granularity,
+                                  const std::string& from, const std::string& to) const
+{
+    int64_t first, last;
+    if (!periodOf(granularity, from, false, first) || !periodOf(granularity, to, true, last))
+    {
+        return CandleSeries();
+    }
+    return queryPeriods(country, granularity, first, last);
+}
+
+CandleSeries CandlePyramid::queryPeriods(Country country, Granularity granularity, int64_t first, int64_t last) const
+{
+    CandleSeries candles;
+    int c = static_cast<int>(country);
+    if (!isBuilt() || c < 0 || c >= COUNTRY_COUNT)
+    {
+        return candles;
+    }
+
+    if (granularity == Granularity::Hour)
+    {
+        return queryHours(country, first, last);
+    }
+
+    const Level& level = levels[levelIndex(granularity)];
+    const std::vector<Aggregate>& aggregates = level.countries[c];
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    size_t i = std::lower_bound(level.periods.begin(), level.periods.end(), first) - level.periods.begin();
+    size_t end = std::upper_bound(level.periods.begin() + i, level.periods.end(), last) - level.periods.begin();
+    candles.reserve(end - i);
+    for (; i < end; ++i)
+    {
+        const Aggregate& a = aggregates[i];
+        if (a.count == 0)
+            continue;
+
+        double open = nan;
+        if (i > 0 && level.periods[i - 1] == level.periods[i] - 1 && aggregates[i - 1].count > 0)
+        {
+            open = aggregates[i - 1].sum / aggregates[i - 1].count;
+        }
+        candles.push_back(level.periods[i], OHLC{open, a.high, a.low, a.sum / a.count});
+    }
+    return candles;
+}
+
+CandleSeries CandlePyramid::queryHours(Country country, int64_t first, int64_t last) const
+{
+    CandleSeries candles;
+    const std::vector<int64_t>& rowHours = source->hours;
+    const double* column = source->column(country);
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    size_t row = std::lower_bound(rowHours.begin(), rowHours.end(), first) - rowHours.begin();
+    size_t end = std::upper_bound(rowHours.begin() + row, rowHours.end(), last) - rowHours.begin();
+
+    // Compressed readings are unpacked for the rows asked for, plus the one before for the first open
+    std::vector<double> unpacked;
+    size_t columnStart = 0; // row held at column[0]
+    if (!column && row < end)
+    {
+        columnStart = (row > 0) ? row - 1 : row;
+        unpacked.resize(end - columnStart);
+        source->decode(country, columnStart, end, unpacked.data());
+        column = unpacked.data();
+    }
+    candles.reserve(end - row);
+    for (; row < end; ++row)
+    {
+        double t = column[row - columnStart];
+        if (std::isnan(t))
+            continue;
+
+        double open = (row > 0 && rowHours[row - 1] == rowHours[row] - 1) ? column[row - 1 - columnStart] : nan;
+        candles.push_back(rowHours[row], OHLC{open, t, t, t});
+    }
+    return candles;
+}
+
+bool CandlePyramid::periodOf(Granularity granularity, const std::string& text, bool atEnd, int64_t& period)
+{
+    // "YYYY", "YYYY-MM", "YYYY-MM-DD" or "YYYY-MM-DDTHH", missing parts at their first or last value
+    int year = 0, month = atEnd ? 12 : 1, day = 1, hour = atEnd ? 23 : 0;
+    int parsedMonth, parsedHour;
+    bool read = false;
+    if (text.size() == 4)
+    {
+        read = TimeIndex::parseYearMonth(text + "-01", year, parsedMonth);
+    }
+    else if (text.size() == 7)
+    {
+        read = TimeIndex::parseYearMonth(text, year, month);
+    }
+    else if (text.size() == 10 || (text.size() == 13 && text[10] == 'T'))
+    {
+        read = TimeIndex::parseDateHour(text, year, month, day, parsedHour);
+        hour = text.size() == 13 ? parsedHour : hour;
+    }
+    if (!read)
+    {
+        return false;
+    }
+
+    // First day of the next month, so a month's last day is the day before
+    int64_t nextMonth = (month == 12) ? TimeIndex::daysFromCivil(year + 1, 1, 1) : TimeIndex::daysFromCivil(year, month + 1, 1);
+    if (TimeIndex::daysFromCivil(year, month, day) >= nextMonth)
+    {
+        return false;
+    }
+    int64_t days = (text.size() < 10 && atEnd) ? nextMonth - 1 : TimeIndex::daysFromCivil(year, month, day);
+
+    switch (granularity)
+    {
+        case Granularity::Hour:  period = days * 24 + hour; break;
+        case Granularity::Day:   period = days; break;
+        case Granularity::Week:  period = weekOfDay(days); break;
+        case Granularity::Month: period = monthOfDay(days); break;
+        case Granularity::Year:  period = yearOfMonth(monthOfDay(days)); break;
+    }
+    return true;
+}
+
+std::string CandlePyramid::periodLabel(Granularity granularity, int64_t period)
+{
+    char buffer[32];
+    int year, month, day;
+    switch (granularity)
+    {
+        case Granularity::Hour:
+            TimeIndex::civilFromDays(floorDiv(period, 24), year, month, day);
+            std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02dT%02d", year, month, day, static_cast<int>(period - floorDiv(period, 24) * 24));
+            break;
+        case Granularity::Day:
+            TimeIndex::civilFromDays(period, year, month, day);
+            std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", year, month, day);
+            break;
+        case Granularity::Week:
+            TimeIndex::civilFromDays(period * 7 - 3, year, month, day);
+            std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", year, month, day);
+            break;
+        case Granularity::Month:
+            std::snprintf(buffer, sizeof(buffer), "%04d-%02d", static_cast<int>(floorDiv(period, 12)), static_cast<int>(period - floorDiv(period, 12) * 12) + 1);
+            break;
+        case Granularity::Year:
+        default:
+            std::snprintf(buffer, sizeof(buffer), "%04d", static_cast<int>(period));
+            break;
+    }
+    return buffer;
+}
+
+bool CandlePyramid::parseGranularity(const std::string& name, Granularity& granularity)
+{
+    if (name == "hourly")
+        granularity = Granularity::Hour;
+    else if (name == "daily")
+        granularity = Granularity::Day;
+    else if (name == "weekly")
+        granularity = Granularity::Week;
+    else if (name == "monthly")
+        granularity = Granularity::Month;
+    else if (name == "yearly")
+        granularity = Granularity::Year;
+    else
+        return false;
+    return true;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "CandleSeries.h"
+#include "DataBookColumns.h"
+#include "OHLCTable.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** time resolution of a candle */
+enum class Granularity { Hour, Day, Week, Month, Year };
+
+/** Multi-resolution candles of every country.
+ *
+ *  Days are aggregated from the hourly readings in one pass over the columns;
+ *  weeks (Monday to Sunday) and months are merged from days, and years from
+ *  months. Hourly candles are the readings themselves. Each candle's close is
+ *  the mean of its readings and its open is the close of the previous period,
+ *  or NaN when that period has no readings. A range query binary-searches its
+ *  first period and then costs O(candles returned). Countries whose column was
+ *  left out have no candles until addCountry(). */
+class CandlePyramid
+{
+    public:
+        CandlePyramid();
+
+        void build(const DataBookColumns& columns);
+        /** add rows appended to columns from firstNewRow on; only the periods they touch
+         *  are aggregated again, so the cost follows the new rows, not the whole axis */
+        void extend(const DataBookColumns& columns, size_t firstNewRow);
+        /** aggregate every period of one country whose column arrived after the build; other
+         *  countries' candles are not touched, so they can be queried meanwhile */
+        void addCountry(const DataBookColumns& columns, Country country);
+        void clear();
+        bool isBuilt() const;
+
+        /** candles of a country whose periods overlap [from, to], keyed by period ordinal; both ends
+         *  are timestamps or prefixes of one ("1980", "1980-06", "1980-06-01", "1980-06-01T12") */
+        CandleSeries query(Country country, Granularity granularity,
+                                        const std::string& from, const std::string& to) const;
+        /** candles of a country in periods [first, last], keyed by period ordinal (see periodOf).
+         *  A candle doesn't depend on the range it was asked in, so ranges can be queried piecemeal */
+        CandleSeries queryPeriods(Country country, Granularity granularity, int64_t first, int64_t last) const;
+
+        /** ordinal of the period holding a "YYYY", "YYYY-MM", "YYYY-MM-DD" or "YYYY-MM-DDTHH" bound,
+         *  false for anything else; atEnd fills the missing parts with their last value (so "1980"
+         *  ends on 1980-12-31T23) */
+        static bool periodOf(Granularity granularity, const std::string& text, bool atEnd, int64_t& period);
+        /** "1980-01-01T05", "1980-01-01", "1979-12-31" (week start), "1980-01" or "1980" */
+        static std::string periodLabel(Granularity granularity, int64_t period);
+        /** "hourly", "daily", "weekly", "monthly" or "yearly" */
+        static bool parseGranularity(const std::string& name, Granularity& granularity);
+
+    private:
+        /** mergeable summary of one country's readings in one period, count 0 = none */
+        class Aggregate
+        {
+            public:
+                double high;
+                double low;
+                double sum;
+                uint32_t count;
+        };
+
+        /** one resolution: sorted period ordinals and, per country, one aggregate per period */
+        class Level
+        {
+            public:
+                std::vector<int64_t> periods;
+                std::vector<std::vector<Aggregate>> countries;
+        };
+
+        /** aggregate rows [firstRow, rowCount) into days, reopening the last day if they continue it */
+        void addRows(const DataBookColumns& columns, size_t firstRow);
+        /** day aggregates of one country from day firstDay on; none while its column is left out */
+        void aggregateDays(const DataBookColumns& columns, int c, size_t firstDay);
+        /** merge consecutive child periods that map to the same parent period, redoing the parents
+         *  from the one holding firstChild; returns the index of the first parent redone */
+        static size_t deriveLevel(const Level& child, Level& parent, int64_t (*parentOf)(int64_t), size_t firstChild);
+        /** merge one country's child aggregates into the parent periods already there */
+        static void deriveCountry(const Level& child, Level& parent, int64_t (*parentOf)(int64_t), int c);
+        static void merge(Aggregate& into, const Aggregate& from);
+
+        CandleSeries queryHours(Country country, int64_t first, int64_t last) const;
+
+        const DataBookColumns* source;
+        /** first row of every day, plus a trailing row count */
+        std::vector<size_t> dayStarts;
+        /** Day, Week, Month and Year levels */
+        Level levels[4];
+};
@@ -0,0 +1,43 @@
+#include "CandleSeries.h"
+
+CandleSeries::CandleSeries()
+{
+}
+
+void CandleSeries::reserve(size_t n)
+{
+    keys.reserve(n);
+    opens.reserve(n);
+    highs.reserve(n);
+    lows.reserve(n);
+    closes.reserve(n);
+}
+
+void CandleSeries::push_back(int64_t key, const OHLC& candle)
+{
+    keys.push_back(key);
+    opens.push_back(candle.open);
+    highs.push_back(candle.high);
+    lows.push_back(candle.low);
+    closes.push_back(candle.close);
+}
+
+void CandleSeries::clear()
+{
+    keys.clear();
+    opens.clear();
+    highs.clear();
+    lows.clear();
+    closes.clear();
+}
+
+CandleSeries CandleSeries::copy() const
+{
+    CandleSeries series;
+    series.keys = keys;
+    series.opens = opens;
+    series.highs = highs;
+    series.lows = lows;
+    series.closes = closes;
+    return series;
+}
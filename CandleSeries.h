@@ -0,0 +1,37 @@
+#pragma once
+
+#include "OHLCTable.h"
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+static_assert(std::is_trivially_copyable<OHLC>::value, "OHLC is copied as plain bytes");
+
+/** Candles in key order as struct-of-arrays, one slot per candle.
+ *  A key is whatever the candles are indexed by: a year for yearly candles,
+ *  a period ordinal (see CandlePyramid::periodOf) for the pyramid's.
+ *  Series are handed on by moving; copying one must be asked for with copy(). */
+class CandleSeries
+{
+    public:
+        CandleSeries();
+        CandleSeries(CandleSeries&&) = default;
+        CandleSeries& operator=(CandleSeries&&) = default;
+        CandleSeries(const CandleSeries&) = delete;
+        CandleSeries& operator=(const CandleSeries&) = delete;
+
+        void reserve(size_t n);
+        void push_back(int64_t key, const OHLC& candle);
+        void clear();
+        CandleSeries copy() const;
+
+        size_t size() const { return keys.size(); }
+        bool empty() const { return keys.empty(); }
+        OHLC at(size_t i) const { return OHLC{opens[i], highs[i], lows[i], closes[i]}; }
+
+        std::vector<int64_t> keys;
+        std::vector<double> opens;
+        std::vector<double> highs;
+        std::vector<double> lows;
+        std::vector<double> closes;
+};
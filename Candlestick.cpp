@@ -1,21 +1,16 @@
 #include "Candlestick.h"
+#include "BatchForecaster.h"
+#include "ChartRenderer.h"
+#include "QueryCache.h"
 #include <algorithm>
 #include <cmath>
-#include <numeric> // For std::accumulate
+#include <limits>
 
-Candlestick::Candlestick(
-    std::vector<double> _opens,
-    std::vector<double> _highs,
-    std::vector<double> _lows,
-    std::vector<double> _closes)
-    : opens(_opens),
-      highs(_highs),
-      lows(_lows),
-      closes(_closes)
+Candlestick::Candlestick()
 {
 }
 
-std::vector<Candlestick> Candlestick::getCandlestickData(Country country, std::string startYear, std::string endYear)
+CandleSeries Candlestick::getCandlestickData(Country country, std::string startYear, std::string endYear)
 {
     int startYear_int = std::stoi(startYear);
     int endYear_int = std::stoi(endYear);
@@ -25,166 +20,154 @@ std::vector<Candlestick> Candlestick::getCandlestickData(Country country, std::s
         throw std::runtime_error("Start year cannot be greater than end year.");
     }
 
-    std::vector<DataBookEntry> allData;
-    std::vector<Candlestick> candlestick_data;
-
-    for (int year = startYear_int; year <= endYear_int; ++year)
+    // The cache holds the table's candles, each open being the previous year's close
+    auto tableCandles = [country](int64_t from, int64_t to)
     {
-        std::string currentYear = std::to_string(year);
-        std::vector<DataBookEntry> yearlyTemps = DataBook::getTemperatures(country, currentYear);
-
-        if (yearlyTemps.empty())
-        {
-            continue;
-        }
-
-        // Append current year entries to allData
-        allData.insert(allData.end(), yearlyTemps.begin(), yearlyTemps.end());
+        CandleSeries candles;
+        const OHLCTable &table = DataBook::getYearlyCandles(country);
 
-        double yearlyOpen;
-        if (year == 1980)
+        // One slot per year the table covers, so filling the series never reallocates
+        int first = static_cast<int>(std::max<int64_t>(from, table.firstYear()));
+        int last = static_cast<int>(std::min<int64_t>(to, table.lastYear()));
+        if (first <= last)
         {
-            yearlyOpen = std::numeric_limits<double>::quiet_NaN();
+            candles.reserve(static_cast<size_t>(last - first + 1));
         }
-        else
+        for (int year = first; year <= last; ++year)
         {
-            try
+            if (table.has(country, year))
             {
-                std::string prevYear = std::to_string(year - 1);
-                yearlyOpen = DataBook::getClose(allData, prevYear);
-            }
-            catch (const std::runtime_error &e)
-            {
-                yearlyOpen = std::numeric_limits<double>::quiet_NaN();
+                candles.push_back(year, table.at(country, year));
             }
         }
+        return candles;
+    };
+    CandleSeries candlestick_data = QueryCache::shared().candles(CachedOperation::YearlyCandles, country, Granularity::Year,
+                                                                 startYear_int, endYear_int, tableCandles);
 
-        double yearlyHigh = DataBook::getHighTemp(yearlyTemps, currentYear);
-        double yearlyLow = DataBook::getLowTemp(yearlyTemps, currentYear);
-        double yearlyClose = DataBook::getClose(yearlyTemps, currentYear);
-
-        std::vector<double> opens{yearlyOpen};
-        std::vector<double> highs{yearlyHigh};
-        std::vector<double> lows{yearlyLow};
-        std::vector<double> closes{yearlyClose};
-
-        if (opens.size() == highs.size() && highs.size() == lows.size() && lows.size() == closes.size())
-        {
-            Candlestick candlestick_entry{opens, highs, lows, closes};
-            candlestick_data.push_back(candlestick_entry);
-        }
-        else
-        {
-            std::cerr << "Inconsistent candlestick data for year: " << currentYear << "\n";
-        }
+    // The first year of the range has no open
+    if (!candlestick_data.empty() && candlestick_data.keys[0] == startYear_int)
+    {
+        candlestick_data.opens[0] = std::numeric_limits<double>::quiet_NaN();
     }
 
     return candlestick_data;
 }
 
-void Candlestick::plotChart(Country country, std::string startYear, std::string endYear, std::vector<Candlestick> chart_data)
+CandleSeries Candlestick::getPeriodData(Country country, Granularity granularity, const std::string& from, const std::string& to)
 {
-    if (chart_data.empty())
+    int64_t first, last;
+    if (!CandlePyramid::periodOf(granularity, from, false, first) || !CandlePyramid::periodOf(granularity, to, true, last))
     {
-        std::cerr << "No data available to plot for the given range.\n";
-        return;
+        throw std::runtime_error("Unreadable range " + from + " to " + to + ".");
     }
 
-    std::string space = "  ";
-    int y_axis_max = std::numeric_limits<int>::min();
-    int y_axis_min = std::numeric_limits<int>::max();
+    const CandlePyramid &pyramid = DataBook::getCandlePyramid(country);
+    return QueryCache::shared().candles(CachedOperation::Candles, country, granularity, first, last,
+                                        [&pyramid, country, granularity](int64_t from, int64_t to)
+                                        {
+                                            return pyramid.queryPeriods(country, granularity, from, to);
+                                        });
+}
 
-    for (const Candlestick &candle : chart_data)
+TemperatureSummary Candlestick::getWindowSummary(Country country, const std::string& from, const std::string& to)
+{
+    int64_t first, last;
+    if (!CandlePyramid::periodOf(Granularity::Hour, from, false, first) || !CandlePyramid::periodOf(Granularity::Hour, to, true, last))
     {
-        if (!candle.highs.empty())
-        {
-            y_axis_max = std::max(y_axis_max, static_cast<int>(*std::max_element(candle.highs.begin(), candle.highs.end())));
-        }
-        if (!candle.lows.empty())
-        {
-            y_axis_min = std::min(y_axis_min, static_cast<int>(*std::min_element(candle.lows.begin(), candle.lows.end())));
-        }
+        throw std::runtime_error("Unreadable window " + from + " to " + to + ".");
     }
+    return DataBook::getRangeSummary(country, first, last);
+}
 
-    if (y_axis_min == std::numeric_limits<int>::max() || y_axis_max == std::numeric_limits<int>::min())
+CandleSeries Candlestick::getWindowCandles(Country country, int64_t periodHours, const std::string& from, const std::string& to)
+{
+    int64_t first, last;
+    if (periodHours <= 0 || !CandlePyramid::periodOf(Granularity::Hour, from, false, first) ||
+        !CandlePyramid::periodOf(Granularity::Hour, to, true, last))
     {
-        std::cerr << "No valid high or low values found for plotting.\n";
-        return;
+        throw std::runtime_error("Unreadable window " + from + " to " + to + ".");
+    }
+    if (first > last)
+    {
+        return CandleSeries();
     }
 
-    // Y-axis : Printed from max to min (top to bottom)
-    for (int i = y_axis_max; i >= y_axis_min; --i)
+    // Only periods that can hold readings are looked at, still aligned to from, so the work
+    // follows the data and not the span asked for
+    int64_t firstHour, lastHour;
+    if (!DataBook::getHourSpan(firstHour, lastHour) || first > lastHour || last < firstHour)
     {
-        // Y-axis : axis (i = temperature)
-        // i = 1 char
-        if (i >= 0 && i <= 9)
-        {
-            std::cout << i << "   | ";
-            // i = 2 chars
-        }
-        else if ((i >= -9 && i <= -1) || (i >= 10 && i <= 99))
-        {
-            std::cout << i << "  | ";
-            // i = 3 chars
-        }
-        else
-        {
-            std::cout << i << " | ";
-        }
+        return CandleSeries();
+    }
+    if (first < firstHour)
+    {
+        first += (firstHour - first) / periodHours * periodHours;
+    }
+    last = std::min(last, lastHour);
 
-        // Print candlesticks
-        for (const Candlestick &candle : chart_data)
+    // Every period is one range query, so any length costs the same; the period before the first gives its open
+    CandleSeries candles;
+    candles.reserve(static_cast<size_t>((last - first) / periodHours + 1));
+    TemperatureSummary previous = DataBook::getRangeSummary(country, first - periodHours, first - 1);
+    for (int64_t start = first; start <= last; start += periodHours)
+    {
+        TemperatureSummary period = DataBook::getRangeSummary(country, start, start + periodHours - 1);
+        if (period.count > 0)
         {
-            if (!candle.highs.empty() && !candle.lows.empty() && !candle.opens.empty() && !candle.closes.empty())
-            {
-                double high = candle.highs[0];
-                double low = candle.lows[0];
-                double open = ceil(candle.opens[0]);
-                double close = floor(candle.closes[0]);
-
-                // Print Highs and Highs to Opens - " || "
-                if (i == static_cast<int>(high) || (i < static_cast<int>(high) && i > static_cast<int>(open)))
-                {
-                    std::cout << " || " << space << space;
-                }
-                // Print Opens and Opens to Closes - "----"
-                else if (i == static_cast<int>(open) || (i < static_cast<int>(open) && i > static_cast<int>(close)))
-                {
-                    std::cout << "----" << space << space;
-                }
-                // Print Closes and Closes to Lows - " || "
-                else if (i == static_cast<int>(close) || (i < static_cast<int>(close) && i > static_cast<int>(low)))
-                {
-                    std::cout << " || " << space << space;
-                }
-                else
-                {
-                    std::cout << space << space << space << space;
-                }
-            }
+            double open = (previous.count > 0) ? previous.sum / previous.count : std::numeric_limits<double>::quiet_NaN();
+            candles.push_back(start, OHLC{open, period.max, period.min, period.sum / period.count});
         }
-        std::cout << std::endl;
+        previous = period;
     }
+    return candles;
+}
 
-    // X-axis : axis, lengthened by 1
-    for (int i = std::stoi(startYear); i <= (std::stoi(endYear) + 1); ++i)
+bool Candlestick::parsePeriod(const std::string& name, int64_t& periodHours)
+{
+    // At most six digits keep a period of days within a few thousand years
+    size_t digits = 0;
+    while (digits < name.size() && name[digits] >= '0' && name[digits] <= '9')
     {
-        std::cout << "--------";
+        ++digits;
+    }
+    if (digits == 0 || digits > 6 || digits + 1 != name.size() || (name.back() != 'h' && name.back() != 'd'))
+    {
+        return false;
     }
 
-    // X-axis : Space from origin to first letter of startYear
-    std::cout << std::endl;
-    std::cout << space << space;
+    int64_t count = std::stoll(name.substr(0, digits));
+    periodHours = (name.back() == 'd') ? count * 24 : count;
+    return periodHours > 0;
+}
 
-    // X-axis : Print startYear to endYear
+void Candlestick::plotChart(Country country, std::string startYear, std::string endYear, const CandleSeries& chart_data, std::ostream& out)
+{
+    if (chart_data.empty())
+    {
+        std::cerr << "No data available to plot for the given range.\n";
+        return;
+    }
+
+    // X-axis : one label per year of the range
+    std::vector<std::string> labels;
     for (int year = std::stoi(startYear); year <= std::stoi(endYear); ++year)
     {
-        std::cout << space << year << space;
+        labels.push_back(std::to_string(year));
+    }
+
+    // Drawn off-screen and written at once, narrowed to the chart width when one is set
+    std::string frame = ChartRenderer{}.render(chart_data, labels);
+    if (frame.empty())
+    {
+        std::cerr << "No valid high or low values found for plotting.\n";
+        return;
     }
-    std::cout << std::endl;
+    out.write(frame.data(), static_cast<std::streamsize>(frame.size()));
+    out.flush();
 }
 
-std::vector<Candlestick> Candlestick::dataPredict(Country country, std::string referStartYear, std::string referEndYear, std::vector<Candlestick> reference)
+CandleSeries Candlestick::dataPredict(Country country, std::string referStartYear, std::string referEndYear, const CandleSeries& reference)
 {
     int startYear = std::stoi(referStartYear);
     int endYear = std::stoi(referEndYear);
@@ -195,85 +178,45 @@ std::vector<Candlestick> Candlestick::dataPredict(Country country, std::string r
         throw std::runtime_error("Invalid reference range or empty reference data.");
     }
 
-    // Helper function: Calculate the linear regression coefficients (slope and intercept)
-    auto linearRegression = [](const std::vector<int> &years, const std::vector<double> &values)
-    {
-        int n = years.size();
-        double sumX = std::accumulate(years.begin(), years.end(), 0.0);
-        double sumY = std::accumulate(values.begin(), values.end(), 0.0);
-        double sumXY = 0.0, sumX2 = 0.0;
-
-        for (int i = 0; i < n; ++i)
-        {
-            sumXY += years[i] * values[i];
-            sumX2 += years[i] * years[i];
-        }
-
-        double slope = (n * sumXY - sumX * sumY) / (n * sumX2 - sumX * sumX);
-        double intercept = (sumY - slope * sumX) / n;
-        return std::make_pair(slope, intercept);
-    };
-
-    // Step 1: Prepare data for regression
-    std::vector<int> years;
-    std::vector<double> avgOpens, avgHighs, avgLows, avgCloses;
+    // Step 1: Accumulate the four regressions (open, high, low, close against year) in one pass
+    CandleRegression regression;
 
-    for (int i = 0; i < reference.size(); ++i)
+    for (size_t i = 0; i < reference.size(); ++i)
     {
-        double avgOpen = std::accumulate(reference[i].opens.begin(), reference[i].opens.end(), 0.0) / reference[i].opens.size();
-        double avgHigh = std::accumulate(reference[i].highs.begin(), reference[i].highs.end(), 0.0) / reference[i].highs.size();
-        double avgLow = std::accumulate(reference[i].lows.begin(), reference[i].lows.end(), 0.0) / reference[i].lows.size();
-        double avgClose = std::accumulate(reference[i].closes.begin(), reference[i].closes.end(), 0.0) / reference[i].closes.size();
+        double open = reference.opens[i];
+        double high = reference.highs[i];
+        double low = reference.lows[i];
+        double close = reference.closes[i];
 
-        if (!std::isnan(avgOpen) && !std::isnan(avgHigh) && !std::isnan(avgLow) && !std::isnan(avgClose))
+        if (!std::isnan(open) && !std::isnan(high) && !std::isnan(low) && !std::isnan(close))
         {
-            years.push_back(startYear + i);
-            avgOpens.push_back(avgOpen);
-            avgHighs.push_back(avgHigh);
-            avgLows.push_back(avgLow);
-            avgCloses.push_back(avgClose);
+            regression.add(startYear + static_cast<int>(i), open, high, low, close);
         }
     }
 
-    if (years.empty())
+    if (regression.count() == 0)
     {
         throw std::runtime_error("No valid data for regression after filtering out NaN values.");
     }
 
-    // Step 2: Perform linear regression for each component
-    std::pair<double, double> openResult = linearRegression(years, avgOpens);
-    double slopeOpen = openResult.first;
-    double interceptOpen = openResult.second;
-
-    std::pair<double, double> highResult = linearRegression(years, avgHighs);
-    double slopeHigh = highResult.first;
-    double interceptHigh = highResult.second;
-
-    std::pair<double, double> lowResult = linearRegression(years, avgLows);
-    double slopeLow = lowResult.first;
-    double interceptLow = lowResult.second;
-
-    std::pair<double, double> closeResult = linearRegression(years, avgCloses);
-    double slopeClose = closeResult.first;
-    double interceptClose = closeResult.second;
-
-    // Step 3: Predict for the next 10 years
-    std::vector<Candlestick> predictions;
+    // Step 2: Predict for the next 10 years
+    CandleSeries predictions;
+    predictions.reserve(10);
     for (int i = 1; i <= 10; ++i)
     {
-        int futureYear = endYear + i;
-
-        double predictedOpen = slopeOpen * futureYear + interceptOpen;
-        double predictedHigh = slopeHigh * futureYear + interceptHigh;
-        double predictedLow = slopeLow * futureYear + interceptLow;
-        double predictedClose = slopeClose * futureYear + interceptClose;
-
-        predictions.emplace_back(
-            std::vector<double>{predictedOpen},
-            std::vector<double>{predictedHigh},
-            std::vector<double>{predictedLow},
-            std::vector<double>{predictedClose});
+        predictions.push_back(endYear + i, regression.predict(endYear + i));
     }
 
     return predictions;
+}
+
+CandleSeries Candlestick::forecast(Country country, std::string referStartYear, std::string referEndYear)
+{
+    return QueryCache::shared().result(CachedOperation::Predict, country, Granularity::Year,
+                                       std::stoi(referStartYear), std::stoi(referEndYear),
+                                       [&]()
+                                       {
+                                           CandleSeries reference = getCandlestickData(country, referStartYear, referEndYear);
+                                           return dataPredict(country, referStartYear, referEndYear, reference);
+                                       });
 }
\ No newline at end of file
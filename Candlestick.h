@@ -3,35 +3,44 @@
 #include "DataBookEntry.h"
 #include "DataBook.h"
 #include "CSVReader.h"
+#include "CandleSeries.h"
+#include "CandlePyramid.h"
 #include <iostream>
 #include <string>
 
 class Candlestick
 {
     public:
-        Candlestick(
-        std::vector <double> _opens,
-        std::vector <double> _highs,
-        std::vector <double> _lows,
-        std::vector <double> _closes
-        );
-
-        std::vector <double> opens;
-        std::vector <double> highs;
-        std::vector <double> lows;
-        std::vector <double> closes;
-
-        /* return vector of candlestick data (open,high,low,close) from startYear to endYear of selected country */
-        /* [{opens},{highs},{lows},{closes}] */
-        std::vector<Candlestick> getCandlestickData(Country country, std::string startYear, std::string endYear);
-
-        /* Text-based plot of the Candlestick data */
-        void plotChart(Country country, std::string startYear, std::string endYear, std::vector<Candlestick> chart_data);
+        Candlestick();
+
+        /* return the yearly candles (open,high,low,close) from startYear to endYear of selected country, keyed by year */
+        /* years without readings are left out; answered from the QueryCache where it can */
+        CandleSeries getCandlestickData(Country country, std::string startYear, std::string endYear);
+
+        /* candles of one resolution between two timestamps or prefixes of one (see CandlePyramid::query), through the QueryCache; */
+        /* throws on an unreadable timestamp */
+        CandleSeries getPeriodData(Country country, Granularity granularity, const std::string& from, const std::string& to);
+
+        /* min, max, sum and count of the readings between two timestamps or prefixes of one, such as the 90 days */
+        /* 2003-05-18 to 2003-08-15; throws on an unreadable timestamp */
+        TemperatureSummary getWindowSummary(Country country, const std::string& from, const std::string& to);
+
+        /* candles of a custom period of periodHours, the first starting at from and the last holding to, keyed by */
+        /* their first epoch hour. high, low and close are the period's max, min and mean, the open the close of */
+        /* the period before (NaN without readings); periods without readings are left out. Throws on an unreadable */
+        /* timestamp */
+        CandleSeries getWindowCandles(Country country, int64_t periodHours, const std::string& from, const std::string& to);
+
+        /* hours of a custom period named "<n>h" or "<n>d", such as "6h" or "90d"; false for any other name */
+        static bool parsePeriod(const std::string& name, int64_t& periodHours);
+
+        /* Text-based plot of the Candlestick data, drawn on out */
+        void plotChart(Country country, std::string startYear, std::string endYear, const CandleSeries& chart_data, std::ostream& out = std::cout);
         
-        /* Predicting Data : pass in Country, referStartYear, referEndYear, and vector<Candlestick> of them */
-        /* Return a vector<Candlestick> of next ten years after referEndYear */
-        std::vector<Candlestick> dataPredict(Country country, std::string referStartYear, std::string referEndYear, std::vector<Candlestick> reference);
+        /* Predicting Data : pass in Country, referStartYear, referEndYear, and the candles of them */
+        /* Return the candles of the next ten years after referEndYear */
+        CandleSeries dataPredict(Country country, std::string referStartYear, std::string referEndYear, const CandleSeries& reference);
 
-    private:
-        std::vector <Candlestick> candlestick_data;
+        /* dataPredict on the candles of referStartYear to referEndYear, remembered in the QueryCache */
+        CandleSeries forecast(Country country, std::string referStartYear, std::string referEndYear);
 };
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "ChartRenderer.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    size_t chartWidth = 0;
+
+    /** row of a value; NaN (an unknown open) lies below every row */
+    int toRow(double value)
+    {
+        return std::isnan(value) ? INT_MIN : static_cast<int>(value);
+    }
+
+    /** chart rows a candle covers, in the order its parts are drawn */
+    class CandleRows
+    {
+        public:
+            int high;
+            int open;
+            int close;
+            int low;
+    };
+}
+
+ChartRenderer::ChartRenderer(size_t _maxWidth)
+: maxWidth(_maxWidth)
+{
+}
+
+size_t ChartRenderer::defaultWidth()
+{
+    return chartWidth;
+}
+
+void ChartRenderer::setDefaultWidth(size_t width)
+{
+    chartWidth = width;
+}
+
+size_t ChartRenderer::terminalWidth()
+{
+    const char* columns = std::getenv("COLUMNS");
+    char* end = nullptr;
+    unsigned long width = columns ? std::strtoul(columns, &end, 10) : 0;
+    if (width == 0 || *end != '\0')
+    {
+        return 80;
+    }
+    return static_cast<size_t>(width);
+}
+
+CandleSeries ChartRenderer::downsample(const CandleSeries& candles, size_t groupSize)
+{
+    groupSize = std::max<size_t>(groupSize, 1);
+    CandleSeries merged;
+    merged.reserve((candles.size() + groupSize - 1) / groupSize);
+    for (size_t first = 0; first < candles.size(); first += groupSize)
+    {
+        size_t last = std::min(first + groupSize, candles.size());
+        OHLC candle = candles.at(first);
+        for (size_t i = first + 1; i < last; ++i)
+        {
+            candle.high = std::max(candle.high, candles.highs[i]);
+            candle.low = std::min(candle.low, candles.lows[i]);
+        }
+        candle.close = candles.closes[last - 1];
+        merged.push_back(candles.keys[first], candle);
+    }
+    return merged;
+}
+
+std::string ChartRenderer::render(const CandleSeries& candles, const std::vector<std::string>& labels) const
+{
+    if (candles.empty())
+    {
+        return std::string();
+    }
+
+    // Merge neighbours until both the candle rows and the x axis (one column longer) fit
+    size_t groupSize = 1;
+    if (maxWidth > 0)
+    {
+        size_t candleColumns = std::max<size_t>(1, maxWidth > AXIS_WIDTH ? (maxWidth - AXIS_WIDTH) / CANDLE_WIDTH : 1);
+        size_t labelColumns = std::max<size_t>(1, maxWidth / CANDLE_WIDTH > 1 ? maxWidth / CANDLE_WIDTH - 1 : 1);
+        groupSize = std::max((candles.size() + candleColumns - 1) / candleColumns,
+                             (labels.size() + labelColumns - 1) / labelColumns);
+    }
+    CandleSeries merged;
+    if (groupSize > 1)
+    {
+        merged = downsample(candles, groupSize);
+    }
+    const CandleSeries& columns = (groupSize > 1) ? merged : candles;
+    std::vector<std::string> columnLabels;
+    for (size_t i = 0; i < labels.size(); i += std::max<size_t>(groupSize, 1))
+    {
+        columnLabels.push_back(labels[i]);
+    }
+
+    std::vector<CandleRows> rows(columns.size());
+    int top = INT_MIN;
+    int bottom = INT_MAX;
+    for (size_t c = 0; c < columns.size(); ++c)
+    {
+        rows[c] = CandleRows{toRow(columns.highs[c]), toRow(std::ceil(columns.opens[c])),
+                             toRow(std::floor(columns.closes[c])), toRow(columns.lows[c])};
+        top = std::max(top, rows[c].high);
+        bottom = std::min(bottom, rows[c].low);
+    }
+    if (top == INT_MIN || bottom == INT_MAX || top < bottom)
+    {
+        return std::string();
+    }
+
+    std::string frame;
+    size_t rowLength = AXIS_WIDTH + 1 + CANDLE_WIDTH * columns.size() + 1;
+    frame.reserve(static_cast<size_t>(top - bottom + 1) * rowLength + 2 * CANDLE_WIDTH * (columnLabels.size() + 2));
+
+    // Y axis from the highest row down, every candle drawn into its 8 character cell
+    for (int i = top; i >= bottom; --i)
+    {
+        std::string label = std::to_string(i);
+        frame += label;
+        frame.append(label.size() < 4 ? 4 - label.size() : 1, ' ');
+        frame += "| ";
+
+        size_t start = frame.size();
+        frame.append(CANDLE_WIDTH * columns.size(), ' ');
+        char* cell = &frame[start];
+        for (const CandleRows& candle : rows)
+        {
+            if (i == candle.high || (i < candle.high && i > candle.open))
+                std::memcpy(cell, " || ", 4);
+            else if (i == candle.open || (i < candle.open && i > candle.close))
+                std::memcpy(cell, "----", 4);
+            else if (i == candle.close || (i < candle.close && i > candle.low))
+                std::memcpy(cell, " || ", 4);
+            cell += CANDLE_WIDTH;
+        }
+        frame += '\n';
+    }
+
+    // X axis, one column longer than the labels, then the labels; labels wider
+    // than a column (such as dates) are shown on every few columns only
+    frame.append(CANDLE_WIDTH * (columnLabels.size() + 1), '-');
+    frame += '\n';
+
+    size_t widest = 0;
+    for (const std::string& label : columnLabels)
+    {
+        widest = std::max(widest, label.size());
+    }
+    size_t every = std::max<size_t>(1, (widest + 4 + CANDLE_WIDTH - 1) / CANDLE_WIDTH);
+    std::string axis(4 + CANDLE_WIDTH * columnLabels.size(), ' ');
+    for (size_t c = 0; c < columnLabels.size(); c += every)
+    {
+        size_t position = 4 + CANDLE_WIDTH * c + 2;
+        if (position + columnLabels[c].size() + 2 > axis.size())
+        {
+            axis.resize(position + columnLabels[c].size() + 2, ' ');
+        }
+        axis.replace(position, columnLabels[c].size(), columnLabels[c]);
+    }
+    frame += axis;
+    frame += '\n';
+    return frame;
+}
+
+void ChartRenderer::draw(const CandleSeries& candles, const std::vector<std::string>& labels, std::ostream& out) const
+{
+    std::string frame = render(candles, labels);
+    out.write(frame.data(), static_cast<std::streamsize>(frame.size()));
+    out.flush();
+}
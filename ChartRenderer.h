@@ -0,0 +1,40 @@
+#pragma once
+
+#include "CandleSeries.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+/** Text candlestick chart drawn into an in-memory framebuffer and written out in one go.
+ *
+ *  One row per degree from the highest high down to the lowest low, a 6 character
+ *  axis label and 8 characters per candle, then the x axis with one label per
+ *  column. When the chart would be wider than maxWidth, adjacent candles (and
+ *  labels) are merged so it fits: open of the first, close of the last, and the
+ *  extreme high and low of the group. */
+class ChartRenderer
+{
+    public:
+        /** maxWidth in characters, 0 = no limit */
+        ChartRenderer(size_t _maxWidth = defaultWidth());
+
+        /** draw candles over labels; an empty string if there is nothing to draw */
+        std::string render(const CandleSeries& candles, const std::vector<std::string>& labels) const;
+        /** render and write with a single write */
+        void draw(const CandleSeries& candles, const std::vector<std::string>& labels, std::ostream& out) const;
+
+        /** merge every groupSize adjacent candles into one, keyed by the first of the group */
+        static CandleSeries downsample(const CandleSeries& candles, size_t groupSize);
+
+        /** width used by charts that don't name one, 0 (no limit) unless set */
+        static size_t defaultWidth();
+        static void setDefaultWidth(size_t width);
+        /** columns of the terminal from the COLUMNS environment variable, 80 when it is unset or unreadable */
+        static size_t terminalWidth();
+
+        static const size_t AXIS_WIDTH = 6;
+        static const size_t CANDLE_WIDTH = 8;
+
+    private:
+        size_t maxWidth;
+};
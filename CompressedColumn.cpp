@@ -0,0 +1,143 @@
+#include "CompressedColumn.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+CompressedColumn::CompressedColumn()
+: rows(0)
+{
+}
+
+void CompressedColumn::encode(const double* first, const double* last)
+{
+    clear();
+    rows = static_cast<size_t>(last - first);
+    blocks.reserve((rows + BLOCK_ROWS - 1) / BLOCK_ROWS);
+
+    for (const double* block = first; block < last; block += BLOCK_ROWS)
+    {
+        const double* blockEnd = std::min(block + BLOCK_ROWS, last);
+
+        // Offsets only if every reading comes back bit for bit (-0.0 and four decimals do not)
+        bool any = false;
+        bool exact = true;
+        int64_t low = std::numeric_limits<int64_t>::max();
+        int64_t high = std::numeric_limits<int64_t>::min();
+        for (const double* p = block; p != blockEnd && exact; ++p)
+        {
+            if (std::isnan(*p))
+                continue;
+            any = true;
+            double scaled = *p * SCALE;
+            if (!(std::fabs(scaled) < 2e9))
+            {
+                exact = false;
+                break;
+            }
+            int64_t code = std::llround(scaled);
+            double decoded = static_cast<double>(code) / SCALE;
+            exact = std::memcmp(&decoded, p, sizeof(double)) == 0;
+            low = std::min(low, code);
+            high = std::max(high, code);
+        }
+
+        if (!any)
+        {
+            blocks.push_back(Block{0, Encoding::Empty, 0});
+        }
+        else if (exact && high - low < MISSING)
+        {
+            blocks.push_back(Block{static_cast<int32_t>(low), Encoding::Offsets, static_cast<uint32_t>(codes.size())});
+            for (const double* p = block; p != blockEnd; ++p)
+            {
+                codes.push_back(std::isnan(*p) ? MISSING : static_cast<uint16_t>(std::llround(*p * SCALE) - low));
+            }
+        }
+        else
+        {
+            blocks.push_back(Block{0, Encoding::Raw, static_cast<uint32_t>(raw.size())});
+            raw.insert(raw.end(), block, blockEnd);
+        }
+    }
+    codes.shrink_to_fit();
+    raw.shrink_to_fit();
+}
+
+void CompressedColumn::clear()
+{
+    rows = 0;
+    std::vector<Block>().swap(blocks);
+    std::vector<uint16_t>().swap(codes);
+    std::vector<double>().swap(raw);
+}
+
+size_t CompressedColumn::capacityBytes() const
+{
+    return blocks.capacity() * sizeof(Block) + codes.capacity() * sizeof(uint16_t) + raw.capacity() * sizeof(double);
+}
+
+void CompressedColumn::decodeBlock(size_t block, size_t first, size_t last, double* out) const
+{
+    const Block& b = blocks[block];
+    size_t offset = b.start + first - block * BLOCK_ROWS;
+    size_t n = last - first;
+    switch (b.encoding)
+    {
+        case Encoding::Empty:
+            std::fill(out, out + n, std::numeric_limits<double>::quiet_NaN());
+            break;
+        case Encoding::Offsets:
+            TemperatureKernels::decodeFixedPoint(codes.data() + offset, n, b.base, SCALE, MISSING, out);
+            break;
+        case Encoding::Raw:
+            std::copy(raw.begin() + offset, raw.begin() + offset + n, out);
+            break;
+    }
+}
+
+void CompressedColumn::decode(size_t firstRow, size_t lastRow, double* out) const
+{
+    lastRow = std::min(lastRow, rows);
+    for (size_t row = firstRow; row < lastRow; )
+    {
+        size_t block = row / BLOCK_ROWS;
+        size_t end = std::min(lastRow, (block + 1) * BLOCK_ROWS);
+        decodeBlock(block, row, end, out);
+        out += end - row;
+        row = end;
+    }
+}
+
+TemperatureSummary CompressedColumn::summarise(size_t firstRow, size_t lastRow) const
+{
+    // Decoded into a small buffer a block at a time; leftovers short of a lane group wait for
+    // the next block, so every reading lands in the same lane as in one summarise call
+    const size_t LANES = TemperatureLanes::LANES;
+    double buffer[BLOCK_ROWS + LANES];
+    size_t held = 0;
+
+    TemperatureLanes lanes;
+    TemperatureKernels::reset(lanes);
+    lastRow = std::min(lastRow, rows);
+    for (size_t row = firstRow; row < lastRow; )
+    {
+        size_t block = row / BLOCK_ROWS;
+        size_t end = std::min(lastRow, (block + 1) * BLOCK_ROWS);
+        if (blocks[block].encoding == Encoding::Empty && held == 0 && (end - row) % LANES == 0)
+        {
+            row = end; // all missing: nothing to fold in
+            continue;
+        }
+
+        decodeBlock(block, row, end, buffer + held);
+        held += end - row;
+        row = end;
+
+        const double* tail = TemperatureKernels::accumulate(lanes, buffer, buffer + held);
+        size_t left = static_cast<size_t>(buffer + held - tail);
+        std::memmove(buffer, tail, left * sizeof(double));
+        held = left;
+    }
+    return TemperatureKernels::finish(lanes, buffer, buffer + held);
+}
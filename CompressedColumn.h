@@ -0,0 +1,63 @@
+#pragma once
+
+#include "TemperatureKernels.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** One country's readings packed as fixed-point codes.
+ *
+ *  Rows are cut into blocks of BLOCK_ROWS. A block of thousandths of a degree
+ *  (every reading the csv can hold) spanning less than 65.535 degrees is stored
+ *  as its lowest value plus one uint16 offset per row, a quarter of the doubles.
+ *  Blocks without readings take no space at all; any other block (more decimals,
+ *  a wider spread) keeps its doubles. Decoding gives back the very doubles that
+ *  were encoded, so summaries over a packed column equal those over the plain one. */
+class CompressedColumn
+{
+    public:
+        CompressedColumn();
+
+        /** pack the readings of [first, last), replacing what was held */
+        void encode(const double* first, const double* last);
+        void clear();
+
+        size_t size() const { return rows; }
+        /** heap bytes held, spare capacity included */
+        size_t capacityBytes() const;
+
+        /** decode rows [firstRow, lastRow) into out */
+        void decode(size_t firstRow, size_t lastRow, double* out) const;
+        /** summary of rows [firstRow, lastRow), decoded a chunk at a time; bit-identical to
+         *  TemperatureKernels::summarise over the plain readings */
+        TemperatureSummary summarise(size_t firstRow, size_t lastRow) const;
+
+        static const size_t BLOCK_ROWS = 256;
+        /** thousandths of a degree per degree */
+        static constexpr double SCALE = 1000.0;
+        static const uint16_t MISSING = 0xFFFF;
+
+    private:
+        enum class Encoding : uint8_t
+        {
+            Empty,   // no readings
+            Offsets, // base + uint16 offset per row, MISSING = no reading
+            Raw      // the doubles themselves
+        };
+
+        class Block
+        {
+            public:
+                int32_t base;
+                Encoding encoding;
+                uint32_t start; // first row of the block in codes or raw
+        };
+
+        /** decode rows [first, last) of one block into out */
+        void decodeBlock(size_t block, size_t first, size_t last, double* out) const;
+
+        size_t rows;
+        std::vector<Block> blocks;
+        std::vector<uint16_t> codes;
+        std::vector<double> raw;
+};
@@ -1,154 +1,486 @@
 #include "DataBook.h"
 #include "CSVReader.h"
+#include "OHLCCache.h"
+#include "DataBookSnapshot.h"
+#include "ShardedDataset.h"
+#include "Metrics.h"
+#include "TemperatureKernels.h"
 #include <map>
 #include <algorithm>
 #include <iostream>
-#include <numeric> // For std::accumulate
+#include <cmath>
+#include <filesystem>
 #include <limits>  // For std::numeric_limits
+#include <stdexcept>
 
-// Define the static member
-std::vector<DataBookEntry> DataBook::datas;
+static_assert(COUNTRY_COUNT <= 32, "DataBook::pendingColumns and indexedColumns have a bit per country");
+
+// Define the static members
+std::string DataBook::sourceFile;
+std::vector<std::string> DataBook::shardFiles;
+std::vector<DataBookColumns> DataBook::parsedShards;
+unsigned int DataBook::loadThreads = 1;
+bool DataBook::readingsLoaded = false;
+bool DataBook::compressedStorage = false;
+bool DataBook::lazyColumns = false;
+bool DataBook::followedFile = false;
+size_t DataBook::parsedBytes = 0;
+std::atomic<uint64_t> DataBook::dataGeneration{0};
+DataBookColumns DataBook::columns;
+TimeIndex DataBook::timeIndex;
+OHLCTable DataBook::yearlyCandles;
+CandlePyramid DataBook::pyramid;
+CSVRowIndex DataBook::rowIndex;
+std::atomic<uint32_t> DataBook::pendingColumns{0};
+bool DataBook::partialCandles = false;
+std::mutex DataBook::columnMutex;
+std::vector<RangeStatsIndex> DataBook::rangeIndexes(COUNTRY_COUNT);
+std::atomic<uint32_t> DataBook::indexedColumns{0};
+std::mutex DataBook::rangeIndexMutex;
 
 /** construct, reading a csv data file */
-DataBook::DataBook(std::string filename)
+DataBook::DataBook(std::string filename, unsigned int threadCount, bool useCache)
 {
-    datas = CSVReader::readCSV(filename);
+    sourceFile = filename;
+    ++dataGeneration;
+    loadThreads = threadCount;
+    readingsLoaded = false;
+    parsedBytes = std::string::npos;
+    columns.clear();
+    timeIndex.clear();
+    pyramid.clear();
+    rowIndex.clear();
+    pendingColumns = 0;
+    partialCandles = false;
+    indexedColumns = 0;
+    shardFiles.clear();
+    parsedShards.clear();
+
+    // Every shard keeps its own sidecar cache; the candles are merged from those
+    if (ShardedDataset::isSharded(filename))
+    {
+        shardFiles = ShardedDataset::shardFiles(filename);
+        if (useCache && ShardedDataset::readYearlyCandles(shardFiles, yearlyCandles, loadThreads, parsedShards))
+        {
+            return;
+        }
+        loadReadings();
+        PhaseTimer timer{LoadPhase::Build};
+        yearlyCandles.build(columns, timeIndex);
+        return;
+    }
+
+    if (DataBookSnapshot::isSnapshot(filename))
+    {
+        {
+            PhaseTimer timer{LoadPhase::Io};
+            DataBookSnapshot::read(filename, columns, timeIndex, yearlyCandles);
+        }
+        if (compressedStorage)
+        {
+            PhaseTimer timer{LoadPhase::Build};
+            columns.compress();
+        }
+        readingsLoaded = true;
+        std::cerr << "DataBook::DataBook mapped snapshot of " << columns.rowCount() << " rows." << std::endl;
+        return;
+    }
+
+    // A followed file mid-way through a line has candles no cache can hold: they would count the partial row
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(filename, error);
+    bool complete = !followedFile || (!error && CSVReader::completeLength(filename) == size);
+
+    bool cached = false;
+    if (useCache && complete)
+    {
+        PhaseTimer timer{LoadPhase::Io};
+        cached = OHLCCache::load(filename, yearlyCandles);
+    }
+    if (cached)
+    {
+        // Readings parsed later must match the candles, even if the file has grown since
+        parsedBytes = error ? std::string::npos : static_cast<size_t>(size);
+        std::cerr << "DataBook::DataBook loaded yearly candles from " << OHLCCache::cacheFilename(filename) << std::endl;
+        return;
+    }
+
+    loadReadings();
+    {
+        PhaseTimer timer{LoadPhase::Build};
+        yearlyCandles.build(columns, timeIndex);
+    }
+    partialCandles = pendingColumns != 0;
+
+    // A table still missing countries is not worth caching, nor one short of a partly written line
+    if (useCache && complete && !partialCandles)
+    {
+        OHLCCache::save(filename, yearlyCandles);
+    }
 }
 
-std::string DataBook::getEarliestYear()
+void DataBook::setCompressedStorage(bool compressed)
 {
-    // Return the earliest year by extracting the year from the first entry
-    return datas[0].timestamp.substr(0, 4); // Extract "YYYY" from "YYYY-MM-DDTHH:MM:SSZ"
+    compressedStorage = compressed;
 }
 
-std::string DataBook::getNextYear(std::string timestamp)
+void DataBook::setLazyColumns(bool lazy)
 {
-    // Extract the year from the given timestamp
-    int currentYear = std::stoi(timestamp.substr(0, 4));
-    std::string nextYear = "";
+    lazyColumns = lazy;
+}
+
+void DataBook::setFollowing(bool following)
+{
+    followedFile = following;
+}
+
+void DataBook::saveSnapshot(const std::string& filename)
+{
+    loadAllColumns();
+    DataBookSnapshot::write(filename, columns, timeIndex, yearlyCandles);
+}
 
-    // Iterate through the dataset to find the next year
-    for (const DataBookEntry &e : datas)
+void DataBook::loadReadings()
+{
+    if (readingsLoaded)
     {
-        int entryYear = std::stoi(e.timestamp.substr(0, 4));
-        if (entryYear > currentYear)
-        {
-            nextYear = std::to_string(entryYear); // Update the next year
-            break;
-        }
+        return;
     }
 
-    // If no later year is found, wrap around to the earliest year
-    if (nextYear.empty())
+    // A followed file's last line may still be being written; refresh() picks it up once it is whole
+    if (shardFiles.empty() && followedFile && parsedBytes == std::string::npos)
     {
-        nextYear = datas[0].timestamp.substr(0, 4); // Return the earliest year
+        parsedBytes = CSVReader::completeLength(sourceFile);
     }
 
-    return nextYear;
+    if (shardFiles.empty() && lazyColumns)
+    {
+        parsedBytes = rowIndex.build(sourceFile, columns, parsedBytes);
+        pendingColumns = static_cast<uint32_t>((uint64_t{1} << COUNTRY_COUNT) - 1);
+    }
+    else if (shardFiles.empty())
+    {
+        parsedBytes = CSVReader::readCSV(sourceFile, columns, loadThreads, parsedBytes);
+    }
+    else
+    {
+        ShardedDataset::read(shardFiles, columns, loadThreads, parsedShards);
+    }
+    PhaseTimer timer{LoadPhase::Build};
+    timeIndex.build(columns.hours);
+    pyramid.build(columns);
+    if (compressedStorage)
+    {
+        columns.compress();
+    }
+    readingsLoaded = true;
 }
 
-std::vector<DataBookEntry> DataBook::getTemperatures(Country country, std::string timestamp)
+void DataBook::loadColumn(Country country)
 {
-    int year = std::stoi(timestamp.substr(0, 4)); // Extract year from timestamp
-    std::vector<DataBookEntry> datas_sub;
+    int c = static_cast<int>(country);
+    if (c < 0 || c >= COUNTRY_COUNT)
+    {
+        return;
+    }
+    loadReadings();
 
-    for (const DataBookEntry &e : datas)
+    uint32_t bit = 1u << c;
+    if (!(pendingColumns & bit))
     {
-        int entryYear = std::stoi(e.timestamp.substr(0, 4)); // Extract year from entry timestamp
-        if (e.country == country && entryYear == year)
-        {
-            datas_sub.push_back(e);
-        }
+        return;
+    }
+    std::lock_guard<std::mutex> lock{columnMutex};
+    if (!(pendingColumns & bit))
+    {
+        return; // another thread parsed it meanwhile
+    }
+    columns.setColumn(country, rowIndex.readColumn(country));
+
+    PhaseTimer timer{LoadPhase::Build};
+    pyramid.addCountry(columns, country);
+    if (partialCandles)
+    {
+        yearlyCandles.addCountry(columns, timeIndex, country);
     }
 
-    return datas_sub;
+    // The file is let go once every country has been parsed
+    if ((pendingColumns &= ~bit) == 0)
+    {
+        rowIndex.clear();
+    }
+}
+
+void DataBook::loadAllColumns()
+{
+    for (int c = 0; c < COUNTRY_COUNT; ++c)
+    {
+        loadColumn(static_cast<Country>(c));
+    }
 }
 
-double DataBook::getHighTemp(std::vector<DataBookEntry> &datas, std::string timestamp)
+size_t DataBook::refresh()
 {
-    double max = std::numeric_limits<double>::lowest(); // Initialize with the lowest possible double value
-    std::string entryYear = timestamp.substr(0, 4);     // Extract the year from the timestamp
+    if (columns.isAttached() || !shardFiles.empty())
+    {
+        return 0;
+    }
+    loadAllColumns();
 
-    for (const DataBookEntry &e : datas)
+    // New rows go into plain columns, packed again once everything is rebuilt; nothing is
+    // unpacked while the file has not grown
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(sourceFile, error);
+    if (columns.isCompressed() && !error && size == parsedBytes)
     {
-        if (e.timestamp.substr(0, 4) == entryYear)
-        {
-            for (double temp : e.temperatures)
-            {
-                if (temp > max)
-                    max = temp;
-            }
-        }
+        return 0;
+    }
+    columns.decompress();
+    size_t newRows = appendNewRows();
+    if (compressedStorage)
+    {
+        columns.compress();
+    }
+    if (newRows > 0)
+    {
+        ++dataGeneration;
+        indexedColumns = 0;
     }
-    return max;
+    return newRows;
 }
 
-double DataBook::getLowTemp(std::vector<DataBookEntry> &datas, std::string timestamp)
+uint64_t DataBook::generation()
 {
-    double min = std::numeric_limits<double>::max(); // Initialize with the highest possible double value
-    std::string entryYear = timestamp.substr(0, 4);  // Extract the year from the timestamp
+    return dataGeneration.load();
+}
+
+size_t DataBook::appendNewRows()
+{
+    size_t firstNewRow = columns.rowCount();
+    try
+    {
+        parsedBytes = CSVReader::readAppended(sourceFile, parsedBytes, columns);
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << "DataBook::refresh reloading " << sourceFile << std::endl;
+        readingsLoaded = false;
+        parsedBytes = std::string::npos;
+        loadReadings();
+        PhaseTimer timer{LoadPhase::Build};
+        yearlyCandles.build(columns, timeIndex);
+        partialCandles = pendingColumns != 0;
+        return columns.rowCount();
+    }
+
+    size_t newRows = columns.rowCount() - firstNewRow;
+    if (newRows == 0)
+    {
+        return 0;
+    }
 
-    for (const DataBookEntry &e : datas)
+    PhaseTimer timer{LoadPhase::Build};
+    if (columns.isSortedByTime(firstNewRow))
     {
-        if (e.timestamp.substr(0, 4) == entryYear)
+        timeIndex.extend(columns.hours, firstNewRow);
+        yearlyCandles.update(columns, timeIndex, firstNewRow);
+        if (pyramid.isBuilt())
         {
-            for (double temp : e.temperatures)
-            {
-                if (temp < min)
-                    min = temp;
-            }
+            pyramid.extend(columns, firstNewRow);
         }
     }
-    return min;
+    else
+    {
+        // Rows older than the ones held: sort and index everything again
+        columns.sortByTime();
+        timeIndex.build(columns.hours);
+        yearlyCandles.build(columns, timeIndex);
+        pyramid.build(columns);
+    }
+    return newRows;
 }
 
-double DataBook::getClose(std::vector<DataBookEntry> &datas, std::string timestamp)
+const OHLCTable& DataBook::getYearlyCandles()
 {
-    // Parse the provided timestamp to extract the year
-    int currentYear = std::stoi(timestamp.substr(0, 4));
+    for (int c = 0; c < COUNTRY_COUNT; ++c)
+    {
+        getYearlyCandles(static_cast<Country>(c));
+    }
+    return yearlyCandles;
+}
 
-    // Search for entries (temperatures) corresponding to the current year
-    std::vector<DataBookEntry> currentYearEntries;
-    
-    // Find the earliest year in the `datas` vector
-    int earliestYear = std::stoi(datas.front().timestamp.substr(0, 4)); // Assuming `datas` is sorted by timestamp
+const OHLCTable& DataBook::getYearlyCandles(Country country)
+{
+    // Only a table built while countries were left out lacks any; one from the cache is whole
+    if (partialCandles)
+    {
+        loadColumn(country);
+    }
+    return yearlyCandles;
+}
 
-    for (const DataBookEntry &entry : datas)
+const CandlePyramid& DataBook::getCandlePyramid()
+{
+    loadReadings();
+    if (!pyramid.isBuilt())
     {
-        int entryYear = std::stoi(entry.timestamp.substr(0, 4));
+        PhaseTimer timer{LoadPhase::Build};
+        pyramid.build(columns);
+    }
+    loadAllColumns();
+    return pyramid;
+}
 
-        // Skip entries from years earlier than the earliest year in `datas`
-        if (entryYear < earliestYear)
-        {
-            continue;
-        }
-        else if (entryYear == currentYear)
+const CandlePyramid& DataBook::getCandlePyramid(Country country)
+{
+    loadReadings();
+    if (!pyramid.isBuilt())
+    {
+        PhaseTimer timer{LoadPhase::Build};
+        pyramid.build(columns);
+    }
+    loadColumn(country);
+    return pyramid;
+}
+
+std::string DataBook::getEarliestYear()
+{
+    return std::to_string(yearlyCandles.firstYear());
+}
+
+std::string DataBook::getNextYear(std::string timestamp)
+{
+    // Extract the year from the given timestamp
+    int currentYear = std::stoi(timestamp.substr(0, 4));
+
+    // Iterate through the years of the candle table to find the next year
+    for (int year = currentYear + 1; year <= yearlyCandles.lastYear(); ++year)
+    {
+        // Countries not parsed yet have no candles, so any row of the year counts then
+        size_t firstRow, lastRow;
+        if (yearlyCandles.hasYear(year) || (partialCandles && timeIndex.yearRows(year, firstRow, lastRow)))
         {
-            currentYearEntries.push_back(entry); // Collect entries for the current year
+            return std::to_string(year);
         }
     }
 
-    // If no data exists for the current year, throw an exception or return an error value
-    if (currentYearEntries.empty())
+    // If no later year is found, wrap around to the earliest year
+    return getEarliestYear();
+}
+
+TemperatureRange DataBook::getTemperatures(Country country, std::string timestamp)
+{
+    return getTemperatures(country, std::stoi(timestamp.substr(0, 4))); // Extract year from timestamp
+}
+
+TemperatureRange DataBook::getTemperatures(Country country, int year)
+{
+    loadColumn(country);
+    loadReadings();
+
+    size_t firstRow, lastRow;
+    if (!timeIndex.yearRows(year, firstRow, lastRow))
     {
-        throw std::runtime_error("No data found for the current year.");
+        return TemperatureRange{};
     }
+    return columns.range(country, firstRow, lastRow);
+}
 
-    // Calculate the average of the mean temperatures for the current year
-    double totalTemperature = 0.0;
-    int temperatureCount = 0;
+TemperatureRange DataBook::getTemperatures(Country country, int year, int month)
+{
+    loadColumn(country);
+    loadReadings();
+
+    size_t firstRow, lastRow;
+    if (!timeIndex.monthRows(year, month, firstRow, lastRow))
+    {
+        return TemperatureRange{};
+    }
+    return columns.range(country, firstRow, lastRow);
+}
+
+TemperatureSummary DataBook::getRangeSummary(Country country, int64_t fromHour, int64_t toHour)
+{
+    int c = static_cast<int>(country);
+    if (c < 0 || c >= COUNTRY_COUNT || fromHour > toHour)
+    {
+        return TemperatureKernels::summarise(nullptr, nullptr);
+    }
+    loadColumn(country);
+    loadReadings();
+
+    size_t firstRow = timeIndex.rowAtOrAfter(columns.hours, fromHour);
+    size_t lastRow = timeIndex.rowAtOrAfter(columns.hours, toHour + 1);
+    return getRangeIndex(country).query(columns, firstRow, lastRow);
+}
+
+bool DataBook::getHourSpan(int64_t& firstHour, int64_t& lastHour)
+{
+    loadReadings();
+    if (columns.hours.empty())
+    {
+        return false;
+    }
+    firstHour = columns.hours.front();
+    lastHour = columns.hours.back();
+    return true;
+}
 
-    for (const DataBookEntry &entry : currentYearEntries)
+const RangeStatsIndex& DataBook::getRangeIndex(Country country)
+{
+    int c = static_cast<int>(country);
+    uint32_t bit = 1u << c;
+    if (!(indexedColumns & bit))
     {
-        // Calculate the mean temperature for the entry
-        double meanTemp = std::accumulate(entry.temperatures.begin(), entry.temperatures.end(), 0.0) / entry.temperatures.size();
+        std::lock_guard<std::mutex> lock{rangeIndexMutex};
+        if (!(indexedColumns & bit))
+        {
+            PhaseTimer timer{LoadPhase::Build};
+            rangeIndexes[c].build(columns, country);
+            indexedColumns |= bit;
+        }
+    }
+    return rangeIndexes[c];
+}
+
+TemperatureSummary DataBook::getSummary(const TemperatureRange &temps)
+{
+    return temps.summarise();
+}
+
+double DataBook::getHighTemp(const TemperatureRange &temps)
+{
+    TemperatureSummary summary = getSummary(temps);
+
+    // Keep the lowest possible double value when there are no readings
+    return summary.count == 0 ? std::numeric_limits<double>::lowest() : summary.max;
+}
+
+double DataBook::getLowTemp(const TemperatureRange &temps)
+{
+    TemperatureSummary summary = getSummary(temps);
 
-        totalTemperature += meanTemp;
-        temperatureCount++;
+    // Keep the highest possible double value when there are no readings
+    return summary.count == 0 ? std::numeric_limits<double>::max() : summary.min;
+}
+
+double DataBook::getClose(const TemperatureRange &temps)
+{
+    TemperatureSummary summary = getSummary(temps);
+
+    // If no data exists for this range, throw an exception
+    if (summary.count == 0)
+    {
+        throw std::runtime_error("No data found for the current year.");
     }
 
     // Compute the overall average
-    double close_averageMeanTemperature = totalTemperature / temperatureCount;
+    double close_averageMeanTemperature = summary.sum / summary.count;
 
     return close_averageMeanTemperature;
-}
\ No newline at end of file
+}
+
+size_t DataBook::getReadingCount(const TemperatureRange &temps)
+{
+    return getSummary(temps).count;
+}
@@ -1,17 +1,75 @@
 #pragma once
 #include "DataBookEntry.h"
+#include "DataBookColumns.h"
+#include "TimeIndex.h"
+#include "OHLCTable.h"
+#include "CandlePyramid.h"
+#include "TemperatureKernels.h"
 #include "CSVReader.h"
+#include "CSVRowIndex.h"
+#include "RangeStatsIndex.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
 #include <string>
 #include <vector>
 
 class DataBook
 {
     public:
-        /** construct, reading a csv data file */
-        DataBook(std::string filename);
+        /** construct, reading a csv data file on threadCount threads (0 = all hardware threads).
+         *  With useCache, yearly candles come from the csv's sidecar cache when it is up to date
+         *  and the raw readings are only parsed on first use.
+         *  A binary snapshot (see DataBookSnapshot) is detected and mapped instead, with no parsing.
+         *  A manifest or glob of csv shards (see ShardedDataset) is read shard by shard and merged */
+        DataBook(std::string filename, unsigned int threadCount = 1, bool useCache = true);
 
-        /** return vector of temperature data according to the sent filters (country and year) */
-        static std::vector<DataBookEntry> getTemperatures(Country country, std::string timestamp);
+        /** keep the readings of books constructed from now on packed as fixed-point blocks (see
+         *  CompressedColumn), about a quarter of the memory, with the same query results */
+        static void setCompressedStorage(bool compressed);
+        /** let books constructed from now on index the rows of a csv and parse a country's readings
+         *  only when a query first asks for that country (see CSVRowIndex); the parsed column is kept.
+         *  Snapshots and sharded datasets are always read whole */
+        static void setLazyColumns(bool lazy);
+
+        /** treat the csv of books constructed from now on as still being written (see refresh):
+         *  the first load stops at its last newline, leaving a partly written line for refresh() */
+        static void setFollowing(bool following);
+
+        /** write the loaded dataset as a binary snapshot */
+        void saveSnapshot(const std::string& filename);
+
+        /** follow a growing csv: parse only the rows appended since the last load or refresh and
+         *  fold them into the columns, time index and candles. returns the number of new rows.
+         *  A truncated or replaced file is reloaded in full; snapshots and sharded datasets never change */
+        static size_t refresh();
+        /** changes whenever a book is constructed or refresh() adds rows, so results computed
+         *  from the data can tell they are out of date (see QueryCache) */
+        static uint64_t generation();
+
+        /** return the contiguous temperature readings of a country for the sent (year) timestamp */
+        static TemperatureRange getTemperatures(Country country, std::string timestamp);
+        /** readings of a country for one year, looked up in the time index */
+        static TemperatureRange getTemperatures(Country country, int year);
+        /** readings of a country for one month (1-12) of a year */
+        static TemperatureRange getTemperatures(Country country, int year, int month);
+        /** min, max, sum and count of a country's readings from fromHour to toHour (epoch hours, both
+         *  included), whatever the window; answered in constant time from the country's
+         *  RangeStatsIndex, built on first use and again after the data changes */
+        static TemperatureSummary getRangeSummary(Country country, int64_t fromHour, int64_t toHour);
+        /** epoch hours of the first and last row; false if there are no rows */
+        static bool getHourSpan(int64_t& firstHour, int64_t& lastHour);
+
+        /** yearly candles of every country, aggregated once at load time */
+        static const OHLCTable& getYearlyCandles();
+        /** the same table, sure to hold the candles of one country only */
+        static const OHLCTable& getYearlyCandles(Country country);
+
+        /** hourly to yearly candles of every country; built with the readings
+         *  (or on first use when the data came from a cache or a snapshot) */
+        static const CandlePyramid& getCandlePyramid();
+        /** the same pyramid, sure to hold the candles of one country only */
+        static const CandlePyramid& getCandlePyramid(Country country);
 
         /** returns the earliest year in the databook*/
         std::string getEarliestYear();
@@ -20,14 +78,59 @@ class DataBook
          * */
         std::string getNextYear(std::string timestamp);
 
-        /* highest temperature value seen this (year) time frame. */
-        static double getHighTemp(std::vector<DataBookEntry> &datas, std::string timestamp);
-        /* lowest temperature value seen this (year) time frame. */
-        static double getLowTemp(std::vector<DataBookEntry> &datas, std::string timestamp);
-        /* the average mean temperature per unit in this (year) time frame. */
-        static double getClose(std::vector<DataBookEntry> &datas, std::string timestamp);
+        /* min, max, sum and count of these readings in one fused pass. */
+        static TemperatureSummary getSummary(const TemperatureRange &temps);
+        /* highest temperature value seen in these readings. */
+        static double getHighTemp(const TemperatureRange &temps);
+        /* lowest temperature value seen in these readings. */
+        static double getLowTemp(const TemperatureRange &temps);
+        /* the average mean temperature of these readings. */
+        static double getClose(const TemperatureRange &temps);
+        /* number of readings that are not missing (NaN). */
+        static size_t getReadingCount(const TemperatureRange &temps);
 
     private:
-        static std::vector<DataBookEntry> datas;
+        /** parse the csv into columns and index it, if that has not happened yet */
+        static void loadReadings();
+        /** parse a country's readings if they were left out, and aggregate them into the pyramid
+         *  and (when it was built without them) the yearly candles. Safe to call from several threads */
+        static void loadColumn(Country country);
+        static void loadAllColumns();
+        /** the range index of a loaded country, built if it is not up to date. Safe to call from several threads */
+        static const RangeStatsIndex& getRangeIndex(Country country);
+        /** the work of refresh() on plain columns; returns the number of new rows */
+        static size_t appendNewRows();
+
+        static std::string sourceFile;
+        /** csv files of a sharded dataset, empty for a single file */
+        static std::vector<std::string> shardFiles;
+        /** shard columns ShardedDataset::readYearlyCandles parsed before falling back to the readings */
+        static std::vector<DataBookColumns> parsedShards;
+        static unsigned int loadThreads;
+        static bool readingsLoaded;
+        static bool compressedStorage;
+        static bool lazyColumns;
+        static bool followedFile;
+        /** bytes of the csv held in columns; after a cache hit, the size the cache was checked against */
+        static size_t parsedBytes;
+        static std::atomic<uint64_t> dataGeneration;
+
+        static DataBookColumns columns;
+        /** year/month -> row range, built once at load time */
+        static TimeIndex timeIndex;
+        static OHLCTable yearlyCandles;
+        static CandlePyramid pyramid;
+        /** rows of the csv whose countries are parsed one at a time; released once all of them are */
+        static CSVRowIndex rowIndex;
+        /** bit c set while Country(c) is left out, so parsed countries are checked without a lock */
+        static std::atomic<uint32_t> pendingColumns;
+        /** yearly candles were built with countries left out, which get theirs when they are parsed */
+        static bool partialCandles;
+        /** guards the columns, pyramid and candles while a country's readings are added */
+        static std::mutex columnMutex;
+        /** [country] range indexes, and a bit per country whose index matches the columns */
+        static std::vector<RangeStatsIndex> rangeIndexes;
+        static std::atomic<uint32_t> indexedColumns;
+        static std::mutex rangeIndexMutex;
 };
 
@@ -0,0 +1,266 @@
+#include "DataBookColumns.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+TemperatureRange::TemperatureRange()
+: first(nullptr),
+  last(nullptr),
+  packed(nullptr),
+  firstRow(0),
+  lastRow(0)
+{
+}
+
+TemperatureRange::TemperatureRange(const double* _first, const double* _last)
+: first(_first),
+  last(_last),
+  packed(nullptr),
+  firstRow(0),
+  lastRow(0)
+{
+}
+
+TemperatureRange::TemperatureRange(const CompressedColumn* _packed, size_t _firstRow, size_t _lastRow)
+: first(nullptr),
+  last(nullptr),
+  packed(_packed),
+  firstRow(_firstRow),
+  lastRow(_lastRow)
+{
+}
+
+TemperatureSummary TemperatureRange::summarise() const
+{
+    return packed ? packed->summarise(firstRow, lastRow) : TemperatureKernels::summarise(first, last);
+}
+
+DataBookColumns::DataBookColumns()
+: temperatures(COUNTRY_COUNT)
+{
+}
+
+void DataBookColumns::addRow(int64_t hour, const double* rowTemperatures)
+{
+    hours.push_back(hour);
+    for (int c = 0; c < COUNTRY_COUNT; ++c)
+    {
+        temperatures[c].push_back(rowTemperatures[c]);
+    }
+}
+
+void DataBookColumns::reserve(size_t rows)
+{
+    hours.reserve(rows);
+    for (std::vector<double>& column : temperatures)
+    {
+        column.reserve(rows);
+    }
+}
+
+void DataBookColumns::resize(size_t rows)
+{
+    hours.resize(rows);
+    for (std::vector<double>& column : temperatures)
+    {
+        column.resize(rows, std::numeric_limits<double>::quiet_NaN());
+    }
+}
+
+void DataBookColumns::clear()
+{
+    attachedStorage.reset();
+    attachedColumns.clear();
+    packedColumns.clear();
+    hours.clear();
+    for (std::vector<double>& column : temperatures)
+    {
+        column.clear();
+    }
+}
+
+size_t DataBookColumns::rowCount() const
+{
+    return hours.size();
+}
+
+size_t DataBookColumns::capacityBytes() const
+{
+    size_t bytes = hours.capacity() * sizeof(int64_t);
+    for (const std::vector<double>& column : temperatures)
+    {
+        bytes += column.capacity() * sizeof(double);
+    }
+    for (const CompressedColumn& column : packedColumns)
+    {
+        bytes += column.capacityBytes();
+    }
+    return bytes;
+}
+
+bool DataBookColumns::isSortedByTime(size_t fromRow) const
+{
+    if (fromRow >= hours.size())
+    {
+        return true;
+    }
+    return std::is_sorted(hours.begin() + (fromRow > 0 ? fromRow - 1 : 0), hours.end());
+}
+
+void DataBookColumns::sortByTime()
+{
+    std::vector<size_t> order(rowCount());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b)
+    {
+        return hours[a] < hours[b];
+    });
+
+    std::vector<int64_t> sortedHours(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        sortedHours[i] = hours[order[i]];
+    }
+    hours.swap(sortedHours);
+
+    std::vector<double> sortedColumn(order.size());
+    for (std::vector<double>& column : temperatures)
+    {
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            sortedColumn[i] = column[order[i]];
+        }
+        column.swap(sortedColumn);
+    }
+}
+
+bool DataBookColumns::hasColumn(Country country) const
+{
+    int c = static_cast<int>(country);
+    if (rowCount() == 0 || isAttached())
+    {
+        return true;
+    }
+    return isCompressed() ? packedColumns[c].size() == rowCount() : temperatures[c].size() == rowCount();
+}
+
+void DataBookColumns::setColumn(Country country, std::vector<double> readings)
+{
+    int c = static_cast<int>(country);
+    if (isCompressed())
+    {
+        packedColumns[c].encode(readings.data(), readings.data() + readings.size());
+        return;
+    }
+    temperatures[c] = std::move(readings);
+}
+
+TemperatureRange DataBookColumns::range(Country country, size_t firstRow, size_t lastRow) const
+{
+    int c = static_cast<int>(country);
+    if (c < 0 || c >= COUNTRY_COUNT || firstRow >= lastRow)
+    {
+        return TemperatureRange{};
+    }
+
+    if (isCompressed())
+    {
+        return TemperatureRange{&packedColumns[c], firstRow, lastRow};
+    }
+    const double* data = column(country);
+    return TemperatureRange{data + firstRow, data + lastRow};
+}
+
+const double* DataBookColumns::column(Country country) const
+{
+    int c = static_cast<int>(country);
+    if (isCompressed())
+    {
+        return nullptr;
+    }
+    return isAttached() ? attachedColumns[c] : temperatures[c].data();
+}
+
+TemperatureSummary DataBookColumns::summarise(Country country, size_t firstRow, size_t lastRow) const
+{
+    if (isCompressed())
+    {
+        return packedColumns[static_cast<int>(country)].summarise(firstRow, lastRow);
+    }
+    const double* data = column(country);
+    return TemperatureKernels::summarise(data + firstRow, data + lastRow);
+}
+
+void DataBookColumns::decode(Country country, size_t firstRow, size_t lastRow, double* out) const
+{
+    if (isCompressed())
+    {
+        packedColumns[static_cast<int>(country)].decode(firstRow, lastRow, out);
+        return;
+    }
+    const double* data = column(country);
+    std::copy(data + firstRow, data + lastRow, out);
+}
+
+void DataBookColumns::compress()
+{
+    if (isCompressed())
+    {
+        return;
+    }
+
+    // Attached columns are packed too; the mapping is let go once they are
+    std::vector<CompressedColumn> packed(COUNTRY_COUNT);
+    for (int c = 0; c < COUNTRY_COUNT; ++c)
+    {
+        if (!hasColumn(static_cast<Country>(c)))
+            continue;
+        const double* data = column(static_cast<Country>(c));
+        packed[c].encode(data, data + rowCount());
+        if (!isAttached())
+        {
+            std::vector<double>().swap(temperatures[c]);
+        }
+    }
+    attachedStorage.reset();
+    attachedColumns.clear();
+    packedColumns.swap(packed);
+}
+
+void DataBookColumns::decompress()
+{
+    if (!isCompressed())
+    {
+        return;
+    }
+
+    for (int c = 0; c < COUNTRY_COUNT; ++c)
+    {
+        if (!hasColumn(static_cast<Country>(c)))
+            continue;
+        temperatures[c].resize(rowCount());
+        packedColumns[c].decode(0, rowCount(), temperatures[c].data());
+    }
+    packedColumns.clear();
+}
+
+bool DataBookColumns::isCompressed() const
+{
+    return !packedColumns.empty();
+}
+
+void DataBookColumns::attach(std::shared_ptr<const MappedFile> storage, const std::vector<const double*>& columnData)
+{
+    for (std::vector<double>& owned : temperatures)
+    {
+        std::vector<double>().swap(owned);
+    }
+    attachedStorage = std::move(storage);
+    attachedColumns = columnData;
+}
+
+bool DataBookColumns::isAttached() const
+{
+    return !attachedColumns.empty();
+}
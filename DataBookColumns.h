@@ -0,0 +1,101 @@
+#pragma once
+
+#include "CompressedColumn.h"
+#include "DataBookEntry.h"
+#include "TemperatureKernels.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/** number of real countries in the Country enum (UNKNOWN excluded) */
+const int COUNTRY_COUNT = static_cast<int>(Country::UNKNOWN);
+
+/** read-only view over a contiguous run of one country's readings.
+ *  Missing readings are stored as NaN and must be skipped by the reader.
+ *  Over a compressed column the view holds rows of it instead of pointers,
+ *  and begin() and end() are null. */
+class TemperatureRange
+{
+    public:
+        TemperatureRange();
+        TemperatureRange(const double* _first, const double* _last);
+        TemperatureRange(const CompressedColumn* _packed, size_t _firstRow, size_t _lastRow);
+
+        const double* begin() const { return first; }
+        const double* end() const { return last; }
+        size_t size() const { return packed ? lastRow - firstRow : static_cast<size_t>(last - first); }
+        bool empty() const { return size() == 0; }
+        /** min, max, sum and count of the readings, whichever way they are stored */
+        TemperatureSummary summarise() const;
+
+        const double* first;
+        const double* last;
+        const CompressedColumn* packed;
+        size_t firstRow;
+        size_t lastRow;
+};
+
+class MappedFile;
+
+/** Columnar temperature store: one shared time axis of epoch hours (hours since
+ *  1970-01-01T00 UTC, see TimeIndex) and one contiguous column of readings per
+ *  country, all of the same length.
+ *  Columns are either owned (temperatures) or attached read-only from
+ *  storage kept alive by the store, such as a mapped snapshot. An owned
+ *  column may also be left out, holding nothing until setColumn() (see
+ *  CSVRowIndex); readers check hasColumn() first. */
+class DataBookColumns
+{
+    public:
+        DataBookColumns();
+
+        /** append one row; temperatures[i] belongs to Country(i), NaN = no reading */
+        void addRow(int64_t hour, const double* temperatures);
+        void reserve(size_t rows);
+        /** grow or shrink every column to rows, new readings are NaN */
+        void resize(size_t rows);
+        void clear();
+
+        size_t rowCount() const;
+        /** heap bytes held by the owned time axis and columns (packed or not), spare capacity included */
+        size_t capacityBytes() const;
+
+        /** true if rows from fromRow on are in time order (and follow the row before fromRow) */
+        bool isSortedByTime(size_t fromRow = 0) const;
+        /** stable sort of all rows by time */
+        void sortByTime();
+
+        /** false for a country left out of the load whose readings have not been set yet */
+        bool hasColumn(Country country) const;
+        /** install a country's readings parsed on their own, one per row; packed straight away
+         *  while the columns are compressed */
+        void setColumn(Country country, std::vector<double> readings);
+
+        /** readings of one country in rows [firstRow, lastRow) */
+        TemperatureRange range(Country country, size_t firstRow, size_t lastRow) const;
+        /** start of a country's column, owned or attached; null while compressed */
+        const double* column(Country country) const;
+        /** summary of a country's readings in rows [firstRow, lastRow), compressed or not */
+        TemperatureSummary summarise(Country country, size_t firstRow, size_t lastRow) const;
+        /** copy a country's readings in rows [firstRow, lastRow) to out, compressed or not */
+        void decode(Country country, size_t firstRow, size_t lastRow, double* out) const;
+
+        /** pack every column (that is not left out) into fixed-point blocks (see CompressedColumn) and drop the doubles.
+         *  Readers go through range(), summarise() or decode(); rows can't be added until decompress() */
+        void compress();
+        void decompress();
+        bool isCompressed() const;
+
+        /** use read-only columns living in storage instead of owned ones.
+         *  columnData holds COUNTRY_COUNT pointers to hours.size() readings each */
+        void attach(std::shared_ptr<const MappedFile> storage, const std::vector<const double*>& columnData);
+        bool isAttached() const;
+
+        std::vector<int64_t> hours;
+        std::vector<std::vector<double>> temperatures; // [country][row], empty while attached
+
+    private:
+        std::shared_ptr<const MappedFile> attachedStorage;
+        std::vector<const double*> attachedColumns;
+        std::vector<CompressedColumn> packedColumns; // [country], empty unless compressed
+};
@@ -1,13 +1,16 @@
 #include "DataBookEntry.h"
+#include "TimeIndex.h"
 #include <unordered_map>
 
-DataBookEntry::DataBookEntry(std::string _timestamp,
+DataBookEntry::DataBookEntry(int64_t _hour,
                             std::vector<double> _temperatures,
                             Country _country) 
-: timestamp(_timestamp),
+: hour(_hour),
   temperatures(_temperatures),
   country(_country)
 {
+    int hourOfDay;
+    TimeIndex::civilFromHours(hour, year, month, day, hourOfDay);
 
 }
 
@@ -34,4 +37,20 @@ Country DataBookEntry::stringToCountry(std::string s)
     }
 
     return Country::UNKNOWN; // Return UNKNOWN if not found
-}
\ No newline at end of file
+}
+
+std::string DataBookEntry::countryToString(Country country)
+{
+    static const char* const codes[] = {
+        "AT", "BE", "BG", "CH", "CZ", "DE", "DK", "EE", "ES", "FI",
+        "FR", "GB", "GR", "HR", "HU", "IE", "IT", "LT", "LU", "LV",
+        "NL", "NO", "PL", "PT", "RO", "SE", "SI", "SK"
+    };
+
+    int c = static_cast<int>(country);
+    if (c < 0 || c >= static_cast<int>(Country::UNKNOWN))
+    {
+        return "UNKNOWN";
+    }
+    return codes[c];
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -12,13 +13,19 @@ enum class Country {
 class DataBookEntry
 {
     public:
-        DataBookEntry(  std::string _timestamp,
+        DataBookEntry(  int64_t _hour,
                         std::vector<double> _temperatures,
                         Country _country);
 
         static Country stringToCountry(std::string s);
+        /** two-letter code of a country, "UNKNOWN" for Country::UNKNOWN */
+        static std::string countryToString(Country country);
         
-        std::string timestamp;
+        /** epoch hour (hours since 1970-01-01T00 UTC) and the date it falls on */
+        int64_t hour;
+        int year;
+        int month;
+        int day;
         std::vector<double> temperatures;
         Country country;
 };
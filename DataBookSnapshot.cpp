@@ -0,0 +1,174 @@
+#include "DataBookSnapshot.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+    const char SNAPSHOT_MAGIC[8] = {'M', 'R', 'K', 'L', 'S', 'N', 'A', 'P'};
+    const uint32_t SNAPSHOT_VERSION = 2;
+    const uint32_t BYTE_ORDER_MARK = 0x01020304;
+    const uint64_t ALIGNMENT = 64;
+
+    uint64_t alignUp(uint64_t n)
+    {
+        return (n + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    void writePadding(std::ofstream& out, uint64_t upTo)
+    {
+        static const char zeros[ALIGNMENT] = {};
+        uint64_t pos = static_cast<uint64_t>(out.tellp());
+        out.write(zeros, static_cast<std::streamsize>(upTo - pos));
+    }
+}
+
+DataBookSnapshot::DataBookSnapshot()
+{
+}
+
+void DataBookSnapshot::write(const std::string& filename, const DataBookColumns& columns,
+                             const TimeIndex& timeIndex, const OHLCTable& candles)
+{
+    const uint64_t rows = columns.rowCount();
+
+    // Small sections are serialised up front so their sizes are known for the header
+    std::ostringstream index;
+    timeIndex.write(index);
+    std::ostringstream candleTable;
+    candles.write(candleTable);
+
+    std::string indexBytes = index.str();
+    std::string candleBytes = candleTable.str();
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrderMark = BYTE_ORDER_MARK;
+    header.rowCount = rows;
+    header.countryCount = COUNTRY_COUNT;
+    header.alignment = static_cast<uint32_t>(ALIGNMENT);
+    header.timeAxisOffset = alignUp(sizeof(Header));
+    header.timeAxisBytes = rows * sizeof(int64_t);
+    header.indexOffset = alignUp(header.timeAxisOffset + header.timeAxisBytes);
+    header.indexBytes = indexBytes.size();
+    header.candlesOffset = alignUp(header.indexOffset + header.indexBytes);
+    header.candlesBytes = candleBytes.size();
+    header.columnsOffset = alignUp(header.candlesOffset + header.candlesBytes);
+    header.columnStride = alignUp(rows * sizeof(double));
+
+    std::ofstream out{filename, std::ios::binary | std::ios::trunc};
+    if (!out)
+    {
+        throw std::runtime_error("Unable to write snapshot " + filename);
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writePadding(out, header.timeAxisOffset);
+    out.write(reinterpret_cast<const char*>(columns.hours.data()), static_cast<std::streamsize>(header.timeAxisBytes));
+    writePadding(out, header.indexOffset);
+    out.write(indexBytes.data(), static_cast<std::streamsize>(indexBytes.size()));
+    writePadding(out, header.candlesOffset);
+    out.write(candleBytes.data(), static_cast<std::streamsize>(candleBytes.size()));
+
+    std::vector<double> unpacked;
+    for (int c = 0; c < COUNTRY_COUNT; ++c)
+    {
+        writePadding(out, header.columnsOffset + c * header.columnStride);
+        const double* column = columns.column(static_cast<Country>(c));
+        if (!column)
+        {
+            unpacked.resize(rows);
+            columns.decode(static_cast<Country>(c), 0, rows, unpacked.data());
+            column = unpacked.data();
+        }
+        out.write(reinterpret_cast<const char*>(column), static_cast<std::streamsize>(rows * sizeof(double)));
+    }
+
+    if (!out)
+    {
+        throw std::runtime_error("Unable to write snapshot " + filename);
+    }
+}
+
+void DataBookSnapshot::read(const std::string& filename, DataBookColumns& columns,
+                            TimeIndex& timeIndex, OHLCTable& candles)
+{
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(filename);
+    const char* base = file->data();
+    const uint64_t size = file->size();
+
+    Header header;
+    if (size < sizeof(header))
+    {
+        throw std::runtime_error("Snapshot is truncated: " + filename);
+    }
+    std::memcpy(&header, base, sizeof(header));
+
+    if (!std::equal(header.magic, header.magic + sizeof(header.magic), SNAPSHOT_MAGIC) ||
+        header.byteOrderMark != BYTE_ORDER_MARK)
+    {
+        throw std::runtime_error("Not a snapshot for this machine: " + filename);
+    }
+    if (header.version != SNAPSHOT_VERSION || header.countryCount != COUNTRY_COUNT)
+    {
+        throw std::runtime_error("Unsupported snapshot version: " + filename);
+    }
+
+    // Compared as "bytes > size - offset" so a crafted header cannot wrap the sums around
+    const uint64_t rows = header.rowCount;
+    if (header.timeAxisOffset > size || header.timeAxisBytes > size - header.timeAxisOffset ||
+        header.indexOffset > size || header.indexBytes > size - header.indexOffset ||
+        header.candlesOffset > size || header.candlesBytes > size - header.candlesOffset ||
+        rows > size / sizeof(int64_t) ||
+        header.timeAxisBytes != rows * sizeof(int64_t) ||
+        header.columnStride < rows * sizeof(double) ||
+        header.columnsOffset > size || header.columnStride > (size - header.columnsOffset) / COUNTRY_COUNT ||
+        header.columnsOffset % ALIGNMENT != 0)
+    {
+        throw std::runtime_error("Snapshot is truncated: " + filename);
+    }
+
+    // Time axis: one block copy of the epoch hours
+    columns.clear();
+    columns.hours.resize(static_cast<size_t>(rows));
+    std::memcpy(columns.hours.data(), base + header.timeAxisOffset, static_cast<size_t>(header.timeAxisBytes));
+    if (!std::is_sorted(columns.hours.begin(), columns.hours.end()))
+    {
+        throw std::runtime_error("Snapshot time axis is corrupt: " + filename);
+    }
+
+    std::istringstream index{std::string(base + header.indexOffset, static_cast<size_t>(header.indexBytes))};
+    std::istringstream candleTable{std::string(base + header.candlesOffset, static_cast<size_t>(header.candlesBytes))};
+    if (!timeIndex.read(index, static_cast<size_t>(rows)) || !candles.read(candleTable))
+    {
+        throw std::runtime_error("Snapshot index is corrupt: " + filename);
+    }
+
+    // The candles must span the index's years, as OHLCTable::build makes them
+    bool spanned = rows == 0 ? candles.lastYear() < candles.firstYear()
+                             : candles.firstYear() == timeIndex.firstYear() && candles.lastYear() == timeIndex.lastYear();
+    if (!spanned)
+    {
+        throw std::runtime_error("Snapshot candles are corrupt: " + filename);
+    }
+
+    // Columns are used straight from the mapping
+    std::vector<const double*> columnData(COUNTRY_COUNT);
+    for (int c = 0; c < COUNTRY_COUNT; ++c)
+    {
+        columnData[c] = reinterpret_cast<const double*>(base + header.columnsOffset + c * header.columnStride);
+    }
+    columns.attach(file, columnData);
+}
+
+bool DataBookSnapshot::isSnapshot(const std::string& filename)
+{
+    std::ifstream in{filename, std::ios::binary};
+    char magic[sizeof(SNAPSHOT_MAGIC)];
+    return in.read(magic, sizeof(magic)) && std::equal(magic, magic + sizeof(magic), SNAPSHOT_MAGIC);
+}
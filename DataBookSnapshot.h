@@ -0,0 +1,53 @@
+#pragma once
+
+#include "DataBookColumns.h"
+#include "TimeIndex.h"
+#include "OHLCTable.h"
+#include <cstdint>
+#include <string>
+
+/** Versioned binary snapshot of a loaded DataBook.
+ *
+ *  Layout (native byte order, all sections 64-byte aligned):
+ *    header       magic "MRKLSNAP", version, byte order mark, row/country counts, section offsets
+ *    time axis    int64 epoch hours[rows]
+ *    time index   TimeIndex::write dump
+ *    candles      OHLCTable::write dump
+ *    columns      one double[rows] per country, columnStride bytes apart
+ *
+ *  Reading maps the file and attaches the columns in place, nothing is parsed. */
+class DataBookSnapshot
+{
+    public:
+        DataBookSnapshot();
+
+        /** write a snapshot, throws std::runtime_error if the file cannot be written */
+        static void write(const std::string& filename, const DataBookColumns& columns,
+                          const TimeIndex& timeIndex, const OHLCTable& candles);
+        /** map a snapshot into columns, index and candles; throws std::runtime_error if it is unreadable */
+        static void read(const std::string& filename, DataBookColumns& columns,
+                         TimeIndex& timeIndex, OHLCTable& candles);
+
+        /** true if the file starts with the snapshot magic */
+        static bool isSnapshot(const std::string& filename);
+
+    private:
+        class Header
+        {
+            public:
+                char magic[8];
+                uint32_t version;
+                uint32_t byteOrderMark;
+                uint64_t rowCount;
+                uint32_t countryCount;
+                uint32_t alignment;
+                uint64_t timeAxisOffset;
+                uint64_t timeAxisBytes;
+                uint64_t indexOffset;
+                uint64_t indexBytes;
+                uint64_t candlesOffset;
+                uint64_t candlesBytes;
+                uint64_t columnsOffset;
+                uint64_t columnStride;
+        };
+};
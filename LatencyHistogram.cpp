@@ -0,0 +1,113 @@
+#include "LatencyHistogram.h"
+#include <cstdio>
+
+LatencyHistogram::LatencyHistogram()
+{
+    clear();
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+    buckets[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    uint64_t seen = maximum.load(std::memory_order_relaxed);
+    while (nanoseconds > seen && !maximum.compare_exchange_weak(seen, nanoseconds, std::memory_order_relaxed))
+    {
+    }
+}
+
+void LatencyHistogram::clear()
+{
+    for (std::atomic<uint64_t>& bucket : buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    total.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    maximum.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const
+{
+    return total.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::max() const
+{
+    return maximum.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const
+{
+    uint64_t n = count();
+    return n == 0 ? 0.0 : static_cast<double>(sum.load(std::memory_order_relaxed)) / n;
+}
+
+uint64_t LatencyHistogram::percentile(double q) const
+{
+    uint64_t n = count();
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    // Rank of the quantile, 1-based, then walk the buckets up to it
+    uint64_t rank = static_cast<uint64_t>(q * n);
+    if (rank < 1)
+        rank = 1;
+    if (rank > n)
+        rank = n;
+
+    uint64_t seen = 0;
+    for (size_t b = 0; b < BUCKET_COUNT; ++b)
+    {
+        seen += buckets[b].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            uint64_t upper = bucketUpper(b);
+            return upper < max() ? upper : max();
+        }
+    }
+    return max();
+}
+
+std::string LatencyHistogram::summary() const
+{
+    char line[256];
+    std::snprintf(line, sizeof(line), "count=%llu mean_us=%.1f p50_us=%.1f p95_us=%.1f p99_us=%.1f max_us=%.1f",
+                  static_cast<unsigned long long>(count()), mean() / 1e3,
+                  percentile(0.50) / 1e3, percentile(0.95) / 1e3, percentile(0.99) / 1e3, max() / 1e3);
+    return line;
+}
+
+size_t LatencyHistogram::bucketOf(uint64_t nanoseconds)
+{
+    if (nanoseconds < SUB_BUCKETS)
+    {
+        return static_cast<size_t>(nanoseconds);
+    }
+
+    // Position of the top bit (at least 4), then the next four bits pick the sub-bucket
+    int exponent = 63;
+    while (!(nanoseconds >> exponent))
+    {
+        --exponent;
+    }
+    size_t sub = static_cast<size_t>(nanoseconds >> (exponent - 4)) & (SUB_BUCKETS - 1);
+    return (exponent - 3) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpper(size_t bucket)
+{
+    if (bucket < SUB_BUCKETS)
+    {
+        return bucket;
+    }
+
+    int exponent = static_cast<int>(bucket / SUB_BUCKETS) + 3;
+    uint64_t sub = bucket % SUB_BUCKETS;
+    uint64_t width = uint64_t(1) << (exponent - 4);
+    return (SUB_BUCKETS + sub) * width + width - 1;
+}
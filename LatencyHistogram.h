@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/** Latency histogram that many threads can record into at once without locking.
+ *  Buckets are log-linear: exact below 16 ns, then 16 buckets per power of two,
+ *  so any percentile is reported within 1/16 (about 6%) of the true value. */
+class LatencyHistogram
+{
+    public:
+        LatencyHistogram();
+
+        void record(uint64_t nanoseconds);
+        void clear();
+
+        uint64_t count() const;
+        uint64_t max() const;
+        double mean() const;
+        /** upper edge, in nanoseconds, of the bucket holding the q quantile (0 to 1) */
+        uint64_t percentile(double q) const;
+
+        /** "count=N mean_us=.. p50_us=.. p95_us=.. p99_us=.. max_us=.." */
+        std::string summary() const;
+
+    private:
+        static const size_t SUB_BUCKETS = 16;
+        static const size_t BUCKET_COUNT = 61 * SUB_BUCKETS;
+
+        static size_t bucketOf(uint64_t nanoseconds);
+        static uint64_t bucketUpper(size_t bucket);
+
+        std::atomic<uint64_t> buckets[BUCKET_COUNT];
+        std::atomic<uint64_t> total;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> maximum;
+};
@@ -0,0 +1,104 @@
+#include "MappedFile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& filename)
+: begin(nullptr),
+  length(0),
+  fileHandle(INVALID_HANDLE_VALUE),
+  mappingHandle(nullptr)
+{
+    // Share with writers too: a followed csv is mapped while another process appends to it
+    fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                             nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Unable to open file " + filename);
+    }
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(fileHandle, &fileSize);
+    length = static_cast<size_t>(fileSize.QuadPart);
+    if (length == 0)
+    {
+        return; // an empty file cannot be mapped, there is nothing to read anyway
+    }
+
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle != nullptr)
+    {
+        begin = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (begin == nullptr)
+    {
+        if (mappingHandle != nullptr)
+            CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        throw std::runtime_error("Unable to map file " + filename);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (begin != nullptr)
+        UnmapViewOfFile(begin);
+    if (mappingHandle != nullptr)
+        CloseHandle(mappingHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& filename)
+: begin(nullptr),
+  length(0)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Unable to open file " + filename);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Unable to stat file " + filename);
+    }
+
+    length = static_cast<size_t>(st.st_size);
+    if (length > 0)
+    {
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Unable to map file " + filename);
+        }
+        // The file is read front to back exactly once
+        madvise(mapping, length, MADV_SEQUENTIAL);
+        begin = static_cast<const char*>(mapping);
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (begin != nullptr)
+        munmap(const_cast<char*>(begin), length);
+}
+
+#endif
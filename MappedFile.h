@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/** Read-only memory mapping of a whole file.
+ *  The mapping is released when the object is destroyed. */
+class MappedFile
+{
+    public:
+        /** map the file, throws std::runtime_error if it cannot be opened */
+        MappedFile(const std::string& filename);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const { return begin; }
+        size_t size() const { return length; }
+        std::string_view view() const { return std::string_view{begin, length}; }
+
+    private:
+        const char* begin;
+        size_t length;
+#ifdef _WIN32
+        void* fileHandle;
+        void* mappingHandle;
+#endif
+};
@@ -2,8 +2,15 @@
 #include <iostream>
 #include <map>
 #include <algorithm>
-
-MerkelMain::MerkelMain()
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+
+/** load on all hardware threads */
+MerkelMain::MerkelMain(std::string datasetFile, bool followDataset)
+: follow(followDataset),
+  databook(datasetFile, 0)
 {
 }
 
@@ -16,10 +23,33 @@ void MerkelMain::init()
     {
         printMenu();
         input = getUserOption();
+        if (follow)
+        {
+            size_t added = DataBook::refresh();
+            if (added > 0)
+            {
+                std::cout << "Picked up " << added << " new rows." << std::endl;
+            }
+        }
         processUserOption(input);
     }
 }
 
+std::vector<std::string> MerkelMain::readQueryScript(std::istream& script)
+{
+    std::vector<std::string> queries;
+    std::string line;
+    while (std::getline(script, line))
+    {
+        line.erase(std::remove_if(line.begin(), line.end(), [](char c) { return c == ' ' || c == '\t' || c == '\r'; }), line.end());
+        if (!line.empty() && line[0] != '#')
+        {
+            queries.push_back(line);
+        }
+    }
+    return queries;
+}
+
 void MerkelMain::printMenu()
 {
     std::cout << std::endl;
@@ -74,57 +104,22 @@ void MerkelMain::printWeatherStats()
             int endYear = std::stoi(tokens[2]);
 
             // Create a Candlestick object and fetch candlestick data
-            Candlestick weather_stats({}, {}, {}, {});
-            std::vector<Candlestick> weather_stats_data = weather_stats.getCandlestickData(country, tokens[1], tokens[2]);
+            QueryTimer timer{QueryKind::Stats};
+            Candlestick weather_stats;
+            CandleSeries weather_stats_data = weather_stats.getCandlestickData(country, tokens[1], tokens[2]);
 
             // Print the candlestick data
             int year = startYear;
-            for (const auto &candle : weather_stats_data)
+            for (size_t i = 0; i < weather_stats_data.size(); ++i)
             {
                 if (year > endYear)
                     break; // Stop if we exceed the range
 
                 std::cout << year << "\t"; // Print the current year
-
-                // Print Open values
-                if (!candle.opens.empty())
-                {
-                    std::cout << candle.opens[0] << "\t";
-                }
-                else
-                {
-                    std::cout << "NaN\t";
-                }
-
-                // Print High values
-                if (!candle.highs.empty())
-                {
-                    std::cout << candle.highs[0] << "\t";
-                }
-                else
-                {
-                    std::cout << "NaN\t";
-                }
-
-                // Print Low values
-                if (!candle.lows.empty())
-                {
-                    std::cout << candle.lows[0] << "\t";
-                }
-                else
-                {
-                    std::cout << "NaN\t";
-                }
-
-                // Print Close values
-                if (!candle.closes.empty())
-                {
-                    std::cout << candle.closes[0] << std::endl;
-                }
-                else
-                {
-                    std::cout << "NaN" << std::endl;
-                }
+                std::cout << weather_stats_data.opens[i] << "\t";
+                std::cout << weather_stats_data.highs[i] << "\t";
+                std::cout << weather_stats_data.lows[i] << "\t";
+                std::cout << weather_stats_data.closes[i] << std::endl;
 
                 ++year;
             }
@@ -160,8 +155,9 @@ void MerkelMain::plotCandlestickChart()
             std::cout << "Candlestick chart of " << tokens[0] << "'s temperature data from " << startYear << " to " << endYear << std::endl;
 
             // Create a Candlestick object and fetch candlestick data
-            Candlestick chart({}, {}, {}, {});
-            std::vector<Candlestick> chart_data = chart.getCandlestickData(country, startYear, endYear);
+            QueryTimer timer{QueryKind::Plot};
+            Candlestick chart;
+            CandleSeries chart_data = chart.getCandlestickData(country, startYear, endYear);
 
             // Plot Candlestick chart
             chart.plotChart(country, startYear, endYear, chart_data);
@@ -199,11 +195,9 @@ void MerkelMain::weatherPredict()
             std::cout << "Next 10 years: " << std::endl;
 
             // Create Candlestick object and fetch candlestick data of reference years
-            Candlestick prediction({}, {}, {}, {});
-            std::vector<Candlestick> refer_data = prediction.getCandlestickData(country, referStartYear, referEndYear);
-
-            // Predict the candlestick data with refer_data
-            std::vector<Candlestick> predict_data = prediction.dataPredict(country, referStartYear, referEndYear, refer_data);
+            QueryTimer timer{QueryKind::Predict};
+            Candlestick prediction;
+            CandleSeries predict_data = prediction.forecast(country, referStartYear, referEndYear);
 
             // Next 10 years
             std::string futureStartYear = std::to_string(int(std::stoi(referEndYear) + 1));
@@ -219,6 +213,329 @@ void MerkelMain::weatherPredict()
     }
 }
 
+int MerkelMain::runBatch(const std::vector<std::string>& queries, std::ostream& out, const std::string& outDir)
+{
+    int failures = 0;
+    for (const std::string& query : queries)
+    {
+        failures += runQueryLine(query, out, outDir);
+    }
+    return failures;
+}
+
+int MerkelMain::runQueryLine(const std::string& query, std::ostream& out, const std::string& outDir)
+{
+    int failures = 0;
+
+    std::vector<std::string> tokens = CSVReader::tokenise(query, ',');
+    Granularity granularity;
+    int64_t periodHours;
+    int windowYears;
+    std::string resolution = (!tokens.empty() && tokens[0].rfind("plot-", 0) == 0) ? tokens[0].substr(5) : tokens[0];
+    if (tokens.size() != 4 || (tokens[0] != "stats" && tokens[0] != "plot" && tokens[0] != "predict" && tokens[0] != "window" &&
+                               !CandlePyramid::parseGranularity(resolution, granularity) &&
+                               !Candlestick::parsePeriod(resolution, periodHours) && !parseBacktest(tokens[0], windowYears)))
+    {
+        out << "error," << query << ",bad query" << std::endl;
+        return 1;
+    }
+
+    // Forecasts of every country run as one batch across the hardware threads
+    if (tokens[0] == "predict" && tokens[1] == "all" && outDir.empty())
+    {
+        try
+        {
+            QueryTimer timer{QueryKind::Predict};
+            return runAllForecasts(std::stoi(tokens[2]), std::stoi(tokens[3]), out);
+        }
+        catch (const std::exception &e)
+        {
+            // unreadable years: report them country by country below
+        }
+    }
+
+    // So do the backtests of every country, sharing one pass over the table
+    if (parseBacktest(tokens[0], windowYears) && tokens[1] == "all" && outDir.empty())
+    {
+        try
+        {
+            QueryTimer timer{QueryKind::Predict};
+            std::vector<Country> all;
+            for (int c = 0; c < COUNTRY_COUNT; ++c)
+                all.push_back(static_cast<Country>(c));
+            BacktestScores scores = BatchForecaster::backtest(all, std::stoi(tokens[2]), std::stoi(tokens[3]), windowYears);
+            writeBacktest(tokens[0], tokens[2] + "," + tokens[3], scores, out);
+            return 0;
+        }
+        catch (const std::exception &e)
+        {
+            // unreadable years or no window: report them country by country below
+        }
+    }
+
+    // "all" expands to one query per country
+    std::vector<Country> countries;
+    if (tokens[1] == "all")
+    {
+        for (int c = 0; c < static_cast<int>(Country::UNKNOWN); ++c)
+            countries.push_back(static_cast<Country>(c));
+    }
+    else
+    {
+        countries.push_back(DataBookEntry::stringToCountry(tokens[1]));
+    }
+
+    for (Country country : countries)
+    {
+        std::string name = DataBookEntry::countryToString(country);
+        std::ofstream file;
+        std::ostream* target = &out;
+        if (!outDir.empty())
+        {
+            std::string extension = (tokens[0].rfind("plot", 0) == 0) ? ".txt" : ".csv";
+            std::string filename = outDir + "/" + tokens[0] + "_" + name + "_" + tokens[2] + "_" + tokens[3] + extension;
+            file.open(filename);
+            if (!file)
+            {
+                out << "error," << query << ",could not write " << filename << std::endl;
+                ++failures;
+                continue;
+            }
+            target = &file;
+        }
+
+        try
+        {
+            if (country == Country::UNKNOWN)
+            {
+                throw std::runtime_error("unknown country " + tokens[1]);
+            }
+            QueryTimer timer{queryKindOf(tokens[0])};
+            runQuery(tokens[0], country, tokens[2], tokens[3], *target);
+        }
+        catch (const std::exception &e)
+        {
+            out << "error," << tokens[0] << "," << name << "," << tokens[2] << "," << tokens[3] << "," << e.what() << std::endl;
+            ++failures;
+        }
+    }
+
+    return failures;
+}
+
+int MerkelMain::runAllForecasts(int startYear, int endYear, std::ostream& out)
+{
+    std::vector<ForecastJob> jobs = BatchForecaster::allCountries(startYear, endYear);
+    ForecastResults results = BatchForecaster::forecast(jobs);
+
+    int failures = 0;
+    out << std::setprecision(8);
+    for (size_t j = 0; j < jobs.size(); ++j)
+    {
+        std::string name = DataBookEntry::countryToString(jobs[j].country);
+        if (results.status[j] != ForecastStatus::OK)
+        {
+            out << "error,predict," << name << "," << startYear << "," << endYear << ","
+                << BatchForecaster::statusMessage(results.status[j]) << std::endl;
+            ++failures;
+            continue;
+        }
+
+        for (int k = 0; k < results.horizon; ++k)
+        {
+            size_t slot = results.slot(j, k);
+            out << "predict," << name << "," << endYear + 1 + k << "," << results.opens[slot] << ","
+                << results.highs[slot] << "," << results.lows[slot] << "," << results.closes[slot] << "\n";
+        }
+    }
+    out.flush();
+    return failures;
+}
+
+void MerkelMain::runQuery(const std::string& kind, Country country, const std::string& startYear, const std::string& endYear, std::ostream& out)
+{
+    std::string name = DataBookEntry::countryToString(country);
+    std::string prefix = kind + "," + name + ",";
+
+    // Candles of one resolution straight from the pyramid, one record per period
+    Candlestick candlestick;
+    Granularity granularity;
+    if (CandlePyramid::parseGranularity(kind, granularity))
+    {
+        out << std::setprecision(8);
+        CandleSeries candles = candlestick.getPeriodData(country, granularity, startYear, endYear);
+        for (size_t i = 0; i < candles.size(); ++i)
+        {
+            out << prefix << CandlePyramid::periodLabel(granularity, candles.keys[i]) << "," << candles.opens[i] << ","
+                << candles.highs[i] << "," << candles.lows[i] << "," << candles.closes[i] << "\n";
+        }
+        out.flush();
+        return;
+    }
+
+    // Chart of one resolution, a column per period (merged to fit the chart width)
+    if (kind.rfind("plot-", 0) == 0 && CandlePyramid::parseGranularity(kind.substr(5), granularity))
+    {
+        CandleSeries periods = candlestick.getPeriodData(country, granularity, startYear, endYear);
+        std::vector<std::string> labels;
+        labels.reserve(periods.size());
+        for (int64_t period : periods.keys)
+        {
+            labels.push_back(CandlePyramid::periodLabel(granularity, period));
+        }
+        writeChart(ChartRenderer{}.render(periods, labels), prefix + startYear + "," + endYear + ",", out);
+        return;
+    }
+
+    // Statistics of one arbitrary window, from the range index
+    if (kind == "window")
+    {
+        TemperatureSummary summary = candlestick.getWindowSummary(country, startYear, endYear);
+        double mean = (summary.count > 0) ? summary.sum / summary.count : std::numeric_limits<double>::quiet_NaN();
+        double low = (summary.count > 0) ? summary.min : std::numeric_limits<double>::quiet_NaN();
+        double high = (summary.count > 0) ? summary.max : std::numeric_limits<double>::quiet_NaN();
+        out << std::setprecision(8) << prefix << startYear << "," << endYear << "," << low << "," << high << ","
+            << mean << "," << summary.count << std::endl;
+        return;
+    }
+
+    // Candles of a custom period, one record (or chart column) per period
+    int64_t periodHours;
+    bool plotPeriods = kind.rfind("plot-", 0) == 0;
+    if (Candlestick::parsePeriod(plotPeriods ? kind.substr(5) : kind, periodHours))
+    {
+        CandleSeries periods = candlestick.getWindowCandles(country, periodHours, startYear, endYear);
+        if (plotPeriods)
+        {
+            std::vector<std::string> labels;
+            labels.reserve(periods.size());
+            for (int64_t hour : periods.keys)
+            {
+                labels.push_back(windowLabel(hour, periodHours));
+            }
+            writeChart(ChartRenderer{}.render(periods, labels), prefix + startYear + "," + endYear + ",", out);
+            return;
+        }
+
+        out << std::setprecision(8);
+        for (size_t i = 0; i < periods.size(); ++i)
+        {
+            out << prefix << windowLabel(periods.keys[i], periodHours) << "," << periods.opens[i] << ","
+                << periods.highs[i] << "," << periods.lows[i] << "," << periods.closes[i] << "\n";
+        }
+        out.flush();
+        return;
+    }
+
+    if (kind == "plot")
+    {
+        // Capture the chart and emit each of its lines as a record
+        std::ostringstream chart;
+        candlestick.plotChart(country, startYear, endYear, candlestick.getCandlestickData(country, startYear, endYear), chart);
+        writeChart(chart.str(), prefix + startYear + "," + endYear + ",", out);
+        return;
+    }
+
+    int windowYears;
+    if (parseBacktest(kind, windowYears))
+    {
+        BacktestScores scores = BatchForecaster::backtest({country}, std::stoi(startYear), std::stoi(endYear), windowYears);
+        writeBacktest(kind, startYear + "," + endYear, scores, out);
+        return;
+    }
+
+    // stats: one record per year with readings in the range; predict: one per forecast year
+    CandleSeries candles = (kind == "predict") ? candlestick.forecast(country, startYear, endYear)
+                                               : candlestick.getCandlestickData(country, startYear, endYear);
+
+    out << std::setprecision(8);
+    for (size_t i = 0; i < candles.size(); ++i)
+    {
+        out << prefix << candles.keys[i] << "," << candles.opens[i] << "," << candles.highs[i] << ","
+            << candles.lows[i] << "," << candles.closes[i] << "\n";
+    }
+    out.flush();
+}
+
+QueryKind MerkelMain::queryKindOf(const std::string& kind)
+{
+    if (kind == "stats")
+        return QueryKind::Stats;
+    if (kind == "predict")
+        return QueryKind::Predict;
+    if (kind == "window")
+        return QueryKind::Window;
+    if (kind.rfind("backtest", 0) == 0)
+        return QueryKind::Backtest;
+    if (kind.rfind("plot", 0) == 0)
+        return QueryKind::Plot;
+    return QueryKind::Candles;
+}
+
+bool MerkelMain::parseBacktest(const std::string& kind, int& windowYears)
+{
+    if (kind == "backtest")
+    {
+        windowYears = 10;
+        return true;
+    }
+    if (kind.rfind("backtest-", 0) != 0 || kind.size() == 9 || kind.size() > 12 ||
+        kind.find_first_not_of("0123456789", 9) != std::string::npos)
+    {
+        return false;
+    }
+    // The first year of a window has no open, so fitting two points takes three years
+    windowYears = std::stoi(kind.substr(9));
+    return windowYears >= 3;
+}
+
+void MerkelMain::writeBacktest(const std::string& kind, const std::string& range, const BacktestScores& scores, std::ostream& out)
+{
+    out << std::setprecision(8);
+    for (size_t i = 0; i < scores.countries.size(); ++i)
+    {
+        std::string prefix = kind + "," + DataBookEntry::countryToString(scores.countries[i]) + "," + range + ",";
+        for (int k = 0; k < scores.horizon; ++k)
+        {
+            size_t slot = scores.slot(i, k);
+            out << prefix << k + 1 << "," << scores.counts[slot];
+            for (int v = 0; v < 4; ++v)
+            {
+                out << "," << scores.mae(slot, v) << "," << scores.rmse(slot, v);
+            }
+            out << "\n";
+        }
+    }
+    out.flush();
+}
+
+std::string MerkelMain::windowLabel(int64_t hour, int64_t periodHours)
+{
+    if (periodHours % 24 == 0 && hour % 24 == 0)
+    {
+        return CandlePyramid::periodLabel(Granularity::Day, hour / 24);
+    }
+    return CandlePyramid::periodLabel(Granularity::Hour, hour);
+}
+
+void MerkelMain::writeChart(const std::string& chart, const std::string& prefix, std::ostream& out)
+{
+    std::string records;
+    size_t start = 0;
+    while (start < chart.size())
+    {
+        size_t end = chart.find('\n', start);
+        if (end == std::string::npos)
+            end = chart.size();
+        records += prefix;
+        records.append(chart, start, end - start);
+        records += '\n';
+        start = end + 1;
+    }
+    out << records;
+    out.flush();
+}
+
 void MerkelMain::gotoNextTimeframe()
 {
     std::cout << "Going to next time frame." << std::endl;
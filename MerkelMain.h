@@ -1,15 +1,40 @@
 #pragma once
 
 #include "Candlestick.h"
+#include "BatchForecaster.h"
+#include "ChartRenderer.h"
+#include "Metrics.h"
 #include <vector>
 #include <string>
 
 class MerkelMain
 {
     public:
-        MerkelMain();
+        /** datasetFile is a csv or a binary snapshot of one. With followDataset the menu
+         *  picks up rows appended to the csv before every option */
+        MerkelMain(std::string datasetFile = "weather_data_EU_1980-2019_temp_only.csv", bool followDataset = false);
         void init();
 
+        /** Batch mode: run queries without the menu, loading the data only once.
+         *  A query is "stats|plot|predict,<country or all>,<start year>,<end year>", or
+         *  "hourly|daily|weekly|monthly|yearly,<country or all>,<from>,<to>" for candles of
+         *  that resolution, from and to being timestamps or prefixes such as 1980-06, or
+         *  "plot-daily,..." (any resolution) for a chart of them.
+         *  "window,<country or all>,<from>,<to>" gives the min, max, mean and count of the
+         *  readings in between, and a custom period such as "90d" or "6h" (or "plot-90d")
+         *  candles of that many days or hours from from to to.
+         *  "backtest,<country or all>,<start year>,<end year>" scores the forecast of every
+         *  10-year window in the range (or n-year with "backtest-<n>") against the actual
+         *  candles: a record per horizon with the MAE and RMSE of open, high, low and close.
+         *  Results are written to out as csv records, or to one file per query in outDir
+         *  when it is not empty. returns the number of queries that failed */
+        int runBatch(const std::vector<std::string>& queries, std::ostream& out, const std::string& outDir = "");
+        /** run one query line as runBatch does; returns the number of failed (country) queries.
+         *  Only reads the loaded DataBook, so several threads may call it at once */
+        static int runQueryLine(const std::string& query, std::ostream& out, const std::string& outDir = "");
+        /** read a query script: one query per line, blank lines and '#' comments skipped */
+        static std::vector<std::string> readQueryScript(std::istream& script);
+
     private:
         void printMenu();
         void printHelp();
@@ -24,12 +49,28 @@ class MerkelMain
         /** TASK 4: Predicting Data and Plotting */
         void weatherPredict();
         
+        /** "predict,all" through BatchForecaster; returns the number of countries that failed */
+        static int runAllForecasts(int startYear, int endYear, std::ostream& out);
+        /** the reference window length of a "backtest" (10 years) or "backtest-<n>" kind, n >= 3; false for other kinds */
+        static bool parseBacktest(const std::string& kind, int& windowYears);
+        /** a record per country and horizon: forecasts scored, then MAE and RMSE of open, high, low and close */
+        static void writeBacktest(const std::string& kind, const std::string& range, const BacktestScores& scores, std::ostream& out);
+        /** emit every line of a chart as a record starting with prefix */
+        static void writeChart(const std::string& chart, const std::string& prefix, std::ostream& out);
+        /** one batch query for one country, records written to out */
+        static void runQuery(const std::string& kind, Country country, const std::string& startYear, const std::string& endYear, std::ostream& out);
+        /** histogram a batch query kind is timed into */
+        static QueryKind queryKindOf(const std::string& kind);
+        /** a custom period's first hour as a day when periods are whole days that start at midnight */
+        static std::string windowLabel(int64_t hour, int64_t periodHours);
+
         void gotoNextTimeframe();
         int getUserOption();
         void processUserOption(int userOption);
         
         std::string currentYear;
+        bool follow;
 
-        DataBook databook{"weather_data_EU_1980-2019_temp_only.csv"};
+        DataBook databook;
 
 };
\ No newline at end of file
@@ -0,0 +1,189 @@
+#include "Metrics.h"
+#include "LatencyHistogram.h"
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    const char* const phaseNames[LOAD_PHASE_COUNT] = {"io", "parse", "tokenise", "number_parse", "build"};
+    const char* const rejectNames[REJECT_REASON_COUNT] = {"missing_cells", "bad_timestamp", "bad_number"};
+    const char* const queryNames[QUERY_KIND_COUNT] = {"stats", "plot", "predict", "candles", "window", "backtest"};
+    const char* const cacheNames[CACHE_OUTCOME_COUNT] = {"hits", "partial_hits", "misses"};
+
+    std::atomic<uint64_t> phaseNanoseconds[LOAD_PHASE_COUNT];
+    std::atomic<uint64_t> phaseCalls[LOAD_PHASE_COUNT];
+    std::atomic<uint64_t> bytesParsed{0};
+    std::atomic<uint64_t> rowsParsed{0};
+    std::atomic<uint64_t> cellsParsed{0};
+    std::atomic<uint64_t> rejected[REJECT_REASON_COUNT];
+    LatencyHistogram queryLatency[QUERY_KIND_COUNT];
+    std::atomic<uint64_t> cacheOutcomes[CACHE_OUTCOME_COUNT];
+    std::atomic<uint64_t> cacheEvictions{0};
+    std::atomic<uint64_t> cacheBytes{0};
+
+    std::string reportPath;
+
+    void writeReport()
+    {
+        std::string report = Metrics::toJson();
+        if (reportPath == "-")
+        {
+            std::cerr << report;
+            return;
+        }
+        std::ofstream out{reportPath};
+        out << report;
+        if (!out)
+        {
+            std::cerr << "Metrics::writeAtExit could not write " << reportPath << std::endl;
+        }
+    }
+}
+
+Metrics::Metrics()
+{
+}
+
+void Metrics::addTime(LoadPhase phase, uint64_t nanoseconds)
+{
+    int p = static_cast<int>(phase);
+    phaseNanoseconds[p].fetch_add(nanoseconds, std::memory_order_relaxed);
+    phaseCalls[p].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::addParsed(uint64_t bytes, uint64_t rows, uint64_t cells)
+{
+    bytesParsed.fetch_add(bytes, std::memory_order_relaxed);
+    rowsParsed.fetch_add(rows, std::memory_order_relaxed);
+    cellsParsed.fetch_add(cells, std::memory_order_relaxed);
+}
+
+void Metrics::addRejected(RejectReason reason, uint64_t rows)
+{
+    rejected[static_cast<int>(reason)].fetch_add(rows, std::memory_order_relaxed);
+}
+
+void Metrics::recordQuery(QueryKind kind, uint64_t nanoseconds)
+{
+    queryLatency[static_cast<int>(kind)].record(nanoseconds);
+}
+
+void Metrics::recordCache(CacheOutcome outcome)
+{
+    cacheOutcomes[static_cast<int>(outcome)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::addCacheEvictions(uint64_t entries)
+{
+    cacheEvictions.fetch_add(entries, std::memory_order_relaxed);
+}
+
+void Metrics::setCacheBytes(uint64_t bytes)
+{
+    cacheBytes.store(bytes, std::memory_order_relaxed);
+}
+
+uint64_t Metrics::rejectedRows()
+{
+    uint64_t total = 0;
+    for (int r = 0; r < REJECT_REASON_COUNT; ++r)
+    {
+        total += rejected[r].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void Metrics::reset()
+{
+    for (int p = 0; p < LOAD_PHASE_COUNT; ++p)
+    {
+        phaseNanoseconds[p] = 0;
+        phaseCalls[p] = 0;
+    }
+    bytesParsed = 0;
+    rowsParsed = 0;
+    cellsParsed = 0;
+    for (int r = 0; r < REJECT_REASON_COUNT; ++r)
+    {
+        rejected[r] = 0;
+    }
+    for (LatencyHistogram& histogram : queryLatency)
+    {
+        histogram.clear();
+    }
+    for (int o = 0; o < CACHE_OUTCOME_COUNT; ++o)
+    {
+        cacheOutcomes[o] = 0;
+    }
+    cacheEvictions = 0;
+}
+
+std::string Metrics::toJson()
+{
+    std::ostringstream json;
+    json << "{\"load\":{\"bytes\":" << bytesParsed.load() << ",\"rows\":" << rowsParsed.load()
+         << ",\"cells\":" << cellsParsed.load() << ",\"rejected\":{\"total\":" << rejectedRows();
+    for (int r = 0; r < REJECT_REASON_COUNT; ++r)
+    {
+        json << ",\"" << rejectNames[r] << "\":" << rejected[r].load();
+    }
+    json << "}},\"phases\":{";
+    for (int p = 0; p < LOAD_PHASE_COUNT; ++p)
+    {
+        json << (p > 0 ? "," : "") << "\"" << phaseNames[p] << "\":{\"ms\":" << phaseNanoseconds[p].load() / 1e6
+             << ",\"calls\":" << phaseCalls[p].load() << "}";
+    }
+    json << "},\"parse_sample_every\":" << PARSE_SAMPLE_EVERY << ",\"queries\":{";
+    for (int q = 0; q < QUERY_KIND_COUNT; ++q)
+    {
+        const LatencyHistogram& h = queryLatency[q];
+        json << (q > 0 ? "," : "") << "\"" << queryNames[q] << "\":{\"count\":" << h.count()
+             << ",\"mean_us\":" << h.mean() / 1e3 << ",\"p50_us\":" << h.percentile(0.50) / 1e3
+             << ",\"p95_us\":" << h.percentile(0.95) / 1e3 << ",\"p99_us\":" << h.percentile(0.99) / 1e3
+             << ",\"max_us\":" << h.max() / 1e3 << "}";
+    }
+    json << "},\"cache\":{";
+    for (int o = 0; o < CACHE_OUTCOME_COUNT; ++o)
+    {
+        json << "\"" << cacheNames[o] << "\":" << cacheOutcomes[o].load() << ",";
+    }
+    json << "\"evictions\":" << cacheEvictions.load() << ",\"bytes\":" << cacheBytes.load() << "}}\n";
+    return json.str();
+}
+
+void Metrics::writeAtExit(const std::string& path)
+{
+    bool registered = !reportPath.empty();
+    reportPath = path;
+    if (!registered)
+    {
+        std::atexit(writeReport);
+    }
+}
+
+PhaseTimer::PhaseTimer(LoadPhase _phase)
+: phase(_phase),
+  started(std::chrono::steady_clock::now())
+{
+}
+
+PhaseTimer::~PhaseTimer()
+{
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - started;
+    Metrics::addTime(phase, static_cast<uint64_t>(elapsed.count()));
+}
+
+QueryTimer::QueryTimer(QueryKind _kind)
+: kind(_kind),
+  started(std::chrono::steady_clock::now())
+{
+}
+
+QueryTimer::~QueryTimer()
+{
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - started;
+    Metrics::recordQuery(kind, static_cast<uint64_t>(elapsed.count()));
+}
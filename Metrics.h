@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/** load phases timed by Metrics */
+enum class LoadPhase
+{
+    Io,          // opening and mapping files, reading caches and snapshots
+    Parse,       // the whole csv row loop
+    Tokenise,    // splitting rows into cells, part of Parse
+    NumberParse, // converting cells to numbers, part of Parse
+    Build        // sorting, stitching and building the index, candle table and pyramid
+};
+const int LOAD_PHASE_COUNT = 5;
+
+/** why a csv row, or a single reading of one, was rejected */
+enum class RejectReason
+{
+    MissingCells, // no comma after the timestamp
+    BadTimestamp,
+    BadNumber     // a malformed reading, left blank; the rest of its row is kept
+};
+const int REJECT_REASON_COUNT = 3;
+
+/** queries timed by Metrics, by the kind of work they do */
+enum class QueryKind
+{
+    Stats,
+    Plot,
+    Predict,
+    Candles, // pyramid candles of one resolution or of a custom period
+    Window,  // statistics of one window, from the range index
+    Backtest
+};
+const int QUERY_KIND_COUNT = 6;
+
+/** how a query fared in the QueryCache */
+enum class CacheOutcome
+{
+    Hit,     // answered from the cache alone
+    Partial, // part cached, only the rest computed
+    Miss
+};
+const int CACHE_OUTCOME_COUNT = 3;
+
+/** Process-wide counters, phase timers and query latency histograms.
+ *
+ *  Everything is a relaxed atomic add, so it stays on. Hot loops keep their own
+ *  tallies and add them once per chunk. Tokenise and NumberParse are timed on
+ *  one row in every PARSE_SAMPLE_EVERY and scaled up; Parse itself is exact.
+ *  The report is JSON, written on demand (the server's "stats" command) or at
+ *  exit (--stats). */
+class Metrics
+{
+    public:
+        Metrics();
+
+        static const uint64_t PARSE_SAMPLE_EVERY = 32;
+
+        static void addTime(LoadPhase phase, uint64_t nanoseconds);
+        static void addParsed(uint64_t bytes, uint64_t rows, uint64_t cells);
+        static void addRejected(RejectReason reason, uint64_t rows = 1);
+        static void recordQuery(QueryKind kind, uint64_t nanoseconds);
+        static void recordCache(CacheOutcome outcome);
+        static void addCacheEvictions(uint64_t entries);
+        /** bytes the QueryCache holds now */
+        static void setCacheBytes(uint64_t bytes);
+
+        static uint64_t rejectedRows();
+        static void reset();
+
+        /** the whole report as one JSON object */
+        static std::string toJson();
+        /** write the report to path ("-" = stderr) when the process exits */
+        static void writeAtExit(const std::string& path);
+};
+
+/** adds the time from construction to destruction to a load phase */
+class PhaseTimer
+{
+    public:
+        PhaseTimer(LoadPhase _phase);
+        ~PhaseTimer();
+
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    private:
+        LoadPhase phase;
+        std::chrono::steady_clock::time_point started;
+};
+
+/** records the time from construction to destruction as one query's latency */
+class QueryTimer
+{
+    public:
+        QueryTimer(QueryKind _kind);
+        ~QueryTimer();
+
+        QueryTimer(const QueryTimer&) = delete;
+        QueryTimer& operator=(const QueryTimer&) = delete;
+
+    private:
+        QueryKind kind;
+        std::chrono::steady_clock::time_point started;
+};
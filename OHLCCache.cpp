@@ -0,0 +1,136 @@
+#include "OHLCCache.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    const char CACHE_MAGIC[8] = {'O', 'H', 'L', 'C', 'C', 'U', 'B', 'E'};
+    const uint32_t CACHE_VERSION = 3;
+
+    /** bytes hashed at each end of the csv for its fingerprint */
+    const size_t FINGERPRINT_BYTES = 1 << 20;
+
+    uint64_t fnv1a(const char* data, size_t size, uint64_t hash)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+}
+
+OHLCCache::OHLCCache()
+{
+}
+
+std::string OHLCCache::cacheFilename(const std::string& csvFile)
+{
+    return csvFile + ".ohlc";
+}
+
+bool OHLCCache::stampSource(const std::string& csvFile, SourceStamp& stamp)
+{
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(csvFile, error);
+    if (error)
+        return false;
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(csvFile, error);
+    if (error)
+        return false;
+
+    stamp.size = size;
+    stamp.modified = static_cast<int64_t>(modified.time_since_epoch().count());
+
+    // Hash the head and the tail of the file: cheap even for huge files, and
+    // catches rewrites that keep the same size and timestamp
+    std::ifstream in{csvFile, std::ios::binary};
+    if (!in)
+        return false;
+
+    std::vector<char> buffer(static_cast<size_t>(std::min<uintmax_t>(size, FINGERPRINT_BYTES)));
+    uint64_t hash = 14695981039346656037ULL;
+
+    in.read(buffer.data(), buffer.size());
+    hash = fnv1a(buffer.data(), static_cast<size_t>(in.gcount()), hash);
+
+    if (size > FINGERPRINT_BYTES)
+    {
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(size - FINGERPRINT_BYTES));
+        in.read(buffer.data(), buffer.size());
+        hash = fnv1a(buffer.data(), static_cast<size_t>(in.gcount()), hash);
+    }
+
+    stamp.fingerprint = hash;
+    return true;
+}
+
+bool OHLCCache::load(const std::string& csvFile, OHLCTable& table)
+{
+    std::ifstream in{cacheFilename(csvFile), std::ios::binary};
+    if (!in)
+        return false;
+
+    char magic[8];
+    uint32_t version = 0;
+    SourceStamp cached;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&cached.size), sizeof(cached.size));
+    in.read(reinterpret_cast<char*>(&cached.modified), sizeof(cached.modified));
+    in.read(reinterpret_cast<char*>(&cached.fingerprint), sizeof(cached.fingerprint));
+    if (!in || !std::equal(magic, magic + sizeof(magic), CACHE_MAGIC) || version != CACHE_VERSION)
+        return false;
+
+    SourceStamp current;
+    if (!stampSource(csvFile, current) ||
+        current.size != cached.size ||
+        current.modified != cached.modified ||
+        current.fingerprint != cached.fingerprint)
+    {
+        return false;
+    }
+
+    return table.read(in);
+}
+
+bool OHLCCache::save(const std::string& csvFile, const OHLCTable& table)
+{
+    SourceStamp stamp;
+    if (!stampSource(csvFile, stamp))
+        return false;
+
+    // Write to a temporary file and rename it into place so readers never see half a cache
+    std::string filename = cacheFilename(csvFile);
+    std::string tmpFilename = filename + ".tmp";
+    {
+        std::ofstream out{tmpFilename, std::ios::binary | std::ios::trunc};
+        out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        out.write(reinterpret_cast<const char*>(&CACHE_VERSION), sizeof(CACHE_VERSION));
+        out.write(reinterpret_cast<const char*>(&stamp.size), sizeof(stamp.size));
+        out.write(reinterpret_cast<const char*>(&stamp.modified), sizeof(stamp.modified));
+        out.write(reinterpret_cast<const char*>(&stamp.fingerprint), sizeof(stamp.fingerprint));
+        table.write(out);
+
+        if (!out)
+        {
+            std::cerr << "OHLCCache::save could not write " << tmpFilename << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tmpFilename, filename, error);
+    if (error)
+    {
+        std::cerr << "OHLCCache::save could not write " << filename << std::endl;
+        std::filesystem::remove(tmpFilename, error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "OHLCTable.h"
+#include <cstdint>
+#include <string>
+
+/** Sidecar cache of the yearly candle table, stored next to the csv as "<csv>.ohlc".
+ *  The cache is only used while the csv's size, modification time and
+ *  content fingerprint still match the ones recorded when it was written. */
+class OHLCCache
+{
+    public:
+        OHLCCache();
+
+        /** fill table from the sidecar of csvFile; false if there is none or it is stale */
+        static bool load(const std::string& csvFile, OHLCTable& table);
+        /** write the sidecar for csvFile; false (and a warning) if it cannot be written */
+        static bool save(const std::string& csvFile, const OHLCTable& table);
+
+        static std::string cacheFilename(const std::string& csvFile);
+
+    private:
+        /** identity of the source csv recorded in the cache header */
+        class SourceStamp
+        {
+            public:
+                uint64_t size;
+                int64_t modified;
+                uint64_t fingerprint;
+        };
+
+        static bool stampSource(const std::string& csvFile, SourceStamp& stamp);
+};
@@ -0,0 +1,218 @@
+#include "OHLCTable.h"
+#include "TemperatureKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+OHLCTable::OHLCTable()
+: baseYear(0),
+  yearCount(0)
+{
+}
+
+void OHLCTable::build(const DataBookColumns& columns, const TimeIndex& index)
+{
+    clear();
+    if (index.firstYear() < 0)
+    {
+        return;
+    }
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    baseYear = index.firstYear();
+    yearCount = index.lastYear() - baseYear + 1;
+    candles.assign(static_cast<size_t>(COUNTRY_COUNT) * yearCount, OHLC{nan, nan, nan, nan});
+    counts.assign(candles.size(), 0);
+
+    summariseYears(columns, index, 0);
+}
+
+void OHLCTable::update(const DataBookColumns& columns, const TimeIndex& index, size_t firstNewRow)
+{
+    if (firstNewRow >= columns.rowCount())
+    {
+        return;
+    }
+
+    if (candles.empty() || firstNewRow == 0 || index.firstYear() != baseYear)
+    {
+        build(columns, index);
+        return;
+    }
+    int year, month, day, hour;
+    TimeIndex::civilFromHours(columns.hours[firstNewRow], year, month, day, hour);
+
+    // Widen the table when the new rows reach into new years
+    int newYearCount = index.lastYear() - baseYear + 1;
+    if (newYearCount > yearCount)
+    {
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        std::vector<OHLC> newCandles(static_cast<size_t>(COUNTRY_COUNT) * newYearCount, OHLC{nan, nan, nan, nan});
+        std::vector<size_t> newCounts(newCandles.size(), 0);
+        for (int c = 0; c < COUNTRY_COUNT; ++c)
+        {
+            std::copy(candles.begin() + c * yearCount, candles.begin() + (c + 1) * yearCount, newCandles.begin() + c * newYearCount);
+            std::copy(counts.begin() + c * yearCount, counts.begin() + (c + 1) * yearCount, newCounts.begin() + c * newYearCount);
+        }
+        candles.swap(newCandles);
+        counts.swap(newCounts);
+        yearCount = newYearCount;
+    }
+
+    summariseYears(columns, index, std::max(0, year - baseYear));
+}
+
+void OHLCTable::addCountry(const DataBookColumns& columns, const TimeIndex& index, Country country)
+{
+    int c = static_cast<int>(country);
+    if (c >= 0 && c < COUNTRY_COUNT && !candles.empty() && columns.hasColumn(country))
+    {
+        summariseCountry(columns, index, c, 0);
+    }
+}
+
+void OHLCTable::summariseYears(const DataBookColumns& columns, const TimeIndex& index, int firstYearIndex)
+{
+    for (int c = 0; c < COUNTRY_COUNT; ++c)
+    {
+        if (columns.hasColumn(static_cast<Country>(c)))
+        {
+            summariseCountry(columns, index, c, firstYearIndex);
+        }
+    }
+}
+
+void OHLCTable::summariseCountry(const DataBookColumns& columns, const TimeIndex& index, int c, int firstYearIndex)
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    size_t previous = static_cast<size_t>(c) * yearCount + firstYearIndex - 1;
+    double prevClose = (firstYearIndex > 0 && counts[previous] > 0) ? candles[previous].close : nan;
+
+    for (int y = firstYearIndex; y < yearCount; ++y)
+    {
+        size_t i = static_cast<size_t>(c) * yearCount + y;
+        candles[i] = OHLC{nan, nan, nan, nan};
+        counts[i] = 0;
+
+        size_t firstRow, lastRow;
+        if (!index.yearRows(baseYear + y, firstRow, lastRow))
+        {
+            prevClose = nan;
+            continue;
+        }
+
+        TemperatureSummary summary = columns.summarise(static_cast<Country>(c), firstRow, lastRow);
+        size_t n = summary.count;
+        if (n == 0)
+        {
+            prevClose = nan;
+            continue;
+        }
+
+        double close = summary.sum / n;
+        candles[i] = OHLC{prevClose, summary.max, summary.min, close};
+        counts[i] = n;
+        prevClose = close;
+    }
+}
+
+void OHLCTable::clear()
+{
+    baseYear = 0;
+    yearCount = 0;
+    candles.clear();
+    counts.clear();
+}
+
+void OHLCTable::assign(int _firstYear, int _yearCount, std::vector<OHLC> _candles, std::vector<size_t> _counts)
+{
+    if (_yearCount <= 0 || _candles.size() != static_cast<size_t>(COUNTRY_COUNT) * _yearCount || _counts.size() != _candles.size())
+    {
+        throw std::runtime_error("Candles and counts do not match the years.");
+    }
+    baseYear = _firstYear;
+    yearCount = _yearCount;
+    candles = std::move(_candles);
+    counts = std::move(_counts);
+}
+
+bool OHLCTable::has(Country country, int year) const
+{
+    return count(country, year) > 0;
+}
+
+const OHLC& OHLCTable::at(Country country, int year) const
+{
+    return candles[cell(country, year)];
+}
+
+size_t OHLCTable::count(Country country, int year) const
+{
+    int c = static_cast<int>(country);
+    if (c < 0 || c >= COUNTRY_COUNT || year < baseYear || year >= baseYear + yearCount)
+    {
+        return 0;
+    }
+    return counts[cell(country, year)];
+}
+
+bool OHLCTable::hasYear(int year) const
+{
+    for (int c = 0; c < COUNTRY_COUNT; ++c)
+    {
+        if (has(static_cast<Country>(c), year))
+            return true;
+    }
+    return false;
+}
+
+void OHLCTable::write(std::ostream& out) const
+{
+    int32_t header[3] = {baseYear, yearCount, COUNTRY_COUNT};
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(candles.data()), candles.size() * sizeof(OHLC));
+    for (size_t n : counts)
+    {
+        uint64_t count64 = n;
+        out.write(reinterpret_cast<const char*>(&count64), sizeof(count64));
+    }
+}
+
+bool OHLCTable::read(std::istream& in)
+{
+    clear();
+
+    int32_t header[3];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+        header[1] < 0 || header[1] > 100000 || header[2] != COUNTRY_COUNT)
+    {
+        return false;
+    }
+
+    baseYear = header[0];
+    yearCount = header[1];
+    candles.resize(static_cast<size_t>(COUNTRY_COUNT) * yearCount);
+    counts.resize(candles.size());
+
+    in.read(reinterpret_cast<char*>(candles.data()), candles.size() * sizeof(OHLC));
+    for (size_t& n : counts)
+    {
+        uint64_t count64 = 0;
+        in.read(reinterpret_cast<char*>(&count64), sizeof(count64));
+        n = static_cast<size_t>(count64);
+    }
+
+    if (!in)
+    {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+size_t OHLCTable::cell(Country country, int year) const
+{
+    return static_cast<size_t>(country) * yearCount + (year - baseYear);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "DataBookColumns.h"
+#include "TimeIndex.h"
+#include <istream>
+#include <ostream>
+#include <vector>
+
+/** one open/high/low/close candle, plain data */
+class OHLC
+{
+    public:
+        double open;
+        double high;
+        double low;
+        double close;
+};
+
+/** Dense (country, year) table of yearly candles.
+ *  Built in one streaming pass over every column; each year's open is the
+ *  previous year's close (NaN when the previous year has no readings).
+ *  Countries whose column was left out get no candles until addCountry(). */
+class OHLCTable
+{
+    public:
+        OHLCTable();
+
+        void build(const DataBookColumns& columns, const TimeIndex& index);
+        /** fold in rows appended from firstNewRow on (index already extended over them).
+         *  Only the years the new rows fall in are summarised again */
+        void update(const DataBookColumns& columns, const TimeIndex& index, size_t firstNewRow);
+        /** summarise every year of one country whose column arrived after the table was built */
+        void addCountry(const DataBookColumns& columns, const TimeIndex& index, Country country);
+        void clear();
+        /** take over candles and counts aggregated elsewhere, laid out as [country * _yearCount + year - _firstYear] */
+        void assign(int _firstYear, int _yearCount, std::vector<OHLC> _candles, std::vector<size_t> _counts);
+
+        int firstYear() const { return baseYear; }
+        int lastYear() const { return baseYear + yearCount - 1; }
+
+        /** true if the country has at least one reading in the year */
+        bool has(Country country, int year) const;
+        /** candle of a country's year, check has() first */
+        const OHLC& at(Country country, int year) const;
+        /** number of readings aggregated into the candle */
+        size_t count(Country country, int year) const;
+        /** true if any country has readings in the year */
+        bool hasYear(int year) const;
+
+        /** raw binary (native byte order) dump of the table, used by the sidecar cache */
+        void write(std::ostream& out) const;
+        /** read a dump made by write(); returns false and leaves the table empty on a bad stream */
+        bool read(std::istream& in);
+
+    private:
+        size_t cell(Country country, int year) const;
+        /** summarise years [firstYearIndex, yearCount) of every country held, opening from the year before */
+        void summariseYears(const DataBookColumns& columns, const TimeIndex& index, int firstYearIndex);
+        /** the same for one country */
+        void summariseCountry(const DataBookColumns& columns, const TimeIndex& index, int c, int firstYearIndex);
+
+        int baseYear;
+        int yearCount;
+        std::vector<OHLC> candles;   // [country * yearCount + year - baseYear]
+        std::vector<size_t> counts;  // same layout, 0 = no readings
+};
@@ -0,0 +1,294 @@
+#include "QueryCache.h"
+#include "DataBook.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+bool QueryCache::Key::operator<(const Key& other) const
+{
+    if (operation != other.operation)
+        return operation < other.operation;
+    if (country != other.country)
+        return country < other.country;
+    if (granularity != other.granularity)
+        return granularity < other.granularity;
+    if (first != other.first)
+        return first < other.first;
+    return last < other.last;
+}
+
+bool QueryCache::Key::sameSeries(const Key& other) const
+{
+    return operation == other.operation && country == other.country && granularity == other.granularity;
+}
+
+QueryCache::QueryCache(size_t _byteLimit)
+: limit(_byteLimit),
+  used(0),
+  generation(0)
+{
+}
+
+QueryCache& QueryCache::shared()
+{
+    static QueryCache cache;
+    return cache;
+}
+
+CandleSeries QueryCache::candles(CachedOperation operation, Country country, Granularity granularity, int64_t first, int64_t last,
+                                 const std::function<CandleSeries(int64_t, int64_t)>& compute)
+{
+    Key key{operation, country, granularity, first, last};
+    std::vector<Entry> held; // entries overlapping the range, in key order
+    uint64_t seen;
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        if (limit == 0)
+        {
+            lock.unlock();
+            return compute(first, last);
+        }
+        checkGeneration();
+        seen = generation;
+
+        // Ranges of one series never overlap, so they come in order and only the first can start before first
+        for (Index::iterator it = firstOverlap(key); it != index.end() && it->first.sameSeries(key) && it->first.first <= last; ++it)
+        {
+            if (it->first.last < first)
+                continue;
+            entries.splice(entries.begin(), entries, it->second);
+            held.push_back(*it->second);
+        }
+    }
+
+    CandleSeries answer;
+    if (held.size() == 1 && held[0].key.first <= first && held[0].key.last >= last)
+    {
+        Metrics::recordCache(CacheOutcome::Hit);
+        append(answer, *held[0].candles, first, last);
+        return answer;
+    }
+
+    // Cached candles where an entry holds them and computed ones in the gaps, already in key order
+    int64_t from = first;
+    for (const Entry& entry : held)
+    {
+        if (entry.key.first > from)
+            append(answer, compute(from, entry.key.first - 1), from, entry.key.first - 1);
+        append(answer, *entry.candles, from, last);
+        from = entry.key.last + 1;
+    }
+    if (from <= last)
+        append(answer, compute(from, last), from, last);
+    Metrics::recordCache(held.empty() ? CacheOutcome::Miss : CacheOutcome::Partial);
+
+    // The new entry also keeps what the overlapping entries held outside the range
+    Key merged{operation, country, granularity, first, last};
+    std::shared_ptr<CandleSeries> candles = std::make_shared<CandleSeries>();
+    if (held.empty())
+    {
+        *candles = answer.copy();
+    }
+    else
+    {
+        const Entry& front = held.front();
+        const Entry& back = held.back();
+        merged.first = std::min(first, front.key.first);
+        merged.last = std::max(last, back.key.last);
+        candles->reserve(answer.size() + front.candles->size() + back.candles->size());
+        append(*candles, *front.candles, merged.first, first - 1);
+        append(*candles, answer, first, last);
+        append(*candles, *back.candles, last + 1, merged.last);
+    }
+    size_t size = bytesOf(*candles);
+
+    std::unique_lock<std::mutex> lock{mutex};
+    checkGeneration();
+    if (generation != seen)
+    {
+        // The data changed while computing: the cached pieces are stale and the answer must not mix them
+        lock.unlock();
+        return compute(first, last);
+    }
+
+    // Replace the entries read only if they are still the ones overlapping, and the merged one fits
+    std::vector<Index::iterator> overlapping;
+    for (Index::iterator it = firstOverlap(merged); it != index.end() && it->first.sameSeries(merged) && it->first.first <= merged.last; ++it)
+    {
+        if (it->first.last >= merged.first)
+            overlapping.push_back(it);
+    }
+    bool unchanged = overlapping.size() == held.size();
+    for (size_t i = 0; unchanged && i < overlapping.size(); ++i)
+    {
+        unchanged = overlapping[i]->second->candles == held[i].candles;
+    }
+    if (unchanged && size <= limit)
+    {
+        for (Index::iterator it : overlapping)
+            erase(it);
+        insert(merged, std::move(candles), size);
+    }
+    return answer;
+}
+
+CandleSeries QueryCache::result(CachedOperation operation, Country country, Granularity granularity, int64_t first, int64_t last,
+                                const std::function<CandleSeries()>& compute)
+{
+    Key key{operation, country, granularity, first, last};
+    uint64_t seen;
+    std::shared_ptr<const CandleSeries> hit;
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        if (limit == 0)
+        {
+            lock.unlock();
+            return compute();
+        }
+        checkGeneration();
+        seen = generation;
+
+        Index::iterator it = index.find(key);
+        if (it != index.end())
+        {
+            entries.splice(entries.begin(), entries, it->second);
+            hit = it->second->candles;
+        }
+    }
+    if (hit)
+    {
+        Metrics::recordCache(CacheOutcome::Hit);
+        return hit->copy();
+    }
+
+    CandleSeries computed = compute();
+    Metrics::recordCache(CacheOutcome::Miss);
+    std::shared_ptr<const CandleSeries> candles = std::make_shared<const CandleSeries>(computed.copy());
+    size_t size = bytesOf(*candles);
+
+    std::lock_guard<std::mutex> lock{mutex};
+    checkGeneration();
+    if (generation == seen && index.find(key) == index.end())
+    {
+        insert(key, std::move(candles), size);
+    }
+    return computed;
+}
+
+void QueryCache::setByteLimit(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    limit = bytes;
+    uint64_t evicted = 0;
+    while (used > limit && !entries.empty())
+    {
+        erase(index.find(entries.back().key));
+        ++evicted;
+    }
+    Metrics::addCacheEvictions(evicted);
+    Metrics::setCacheBytes(used);
+}
+
+size_t QueryCache::byteLimit() const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return limit;
+}
+
+size_t QueryCache::bytes() const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return used;
+}
+
+size_t QueryCache::entryCount() const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return entries.size();
+}
+
+void QueryCache::clear()
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    entries.clear();
+    index.clear();
+    used = 0;
+    Metrics::setCacheBytes(used);
+}
+
+void QueryCache::insert(const Key& key, std::shared_ptr<const CandleSeries> candles, size_t bytes)
+{
+    if (bytes > limit)
+    {
+        Metrics::setCacheBytes(used);
+        return;
+    }
+
+    uint64_t evicted = 0;
+    while (used + bytes > limit && !entries.empty())
+    {
+        erase(index.find(entries.back().key));
+        ++evicted;
+    }
+    entries.push_front(Entry{key, std::move(candles), bytes});
+    index[key] = entries.begin();
+    used += bytes;
+    Metrics::addCacheEvictions(evicted);
+    Metrics::setCacheBytes(used);
+}
+
+void QueryCache::erase(Index::iterator position)
+{
+    used -= position->second->bytes;
+    entries.erase(position->second);
+    index.erase(position);
+}
+
+QueryCache::Index::iterator QueryCache::firstOverlap(const Key& key)
+{
+    Key start{key.operation, key.country, key.granularity, key.first, std::numeric_limits<int64_t>::min()};
+    Index::iterator it = index.lower_bound(start);
+    if (it != index.begin())
+    {
+        Index::iterator before = std::prev(it);
+        if (before->first.sameSeries(key) && before->first.last >= key.first)
+            return before;
+    }
+    return it;
+}
+
+void QueryCache::checkGeneration()
+{
+    uint64_t current = DataBook::generation();
+    if (current != generation)
+    {
+        entries.clear();
+        index.clear();
+        used = 0;
+        generation = current;
+        Metrics::setCacheBytes(used);
+    }
+}
+
+void QueryCache::append(CandleSeries& to, const CandleSeries& from, int64_t first, int64_t last)
+{
+    if (first > last)
+        return;
+    size_t begin = std::lower_bound(from.keys.begin(), from.keys.end(), first) - from.keys.begin();
+    size_t end = std::upper_bound(from.keys.begin() + begin, from.keys.end(), last) - from.keys.begin();
+
+    to.keys.insert(to.keys.end(), from.keys.begin() + begin, from.keys.begin() + end);
+    to.opens.insert(to.opens.end(), from.opens.begin() + begin, from.opens.begin() + end);
+    to.highs.insert(to.highs.end(), from.highs.begin() + begin, from.highs.begin() + end);
+    to.lows.insert(to.lows.end(), from.lows.begin() + begin, from.lows.begin() + end);
+    to.closes.insert(to.closes.end(), from.closes.begin() + begin, from.closes.begin() + end);
+}
+
+size_t QueryCache::bytesOf(const CandleSeries& candles)
+{
+    // The candles plus a rough allowance for the list and map nodes around them
+    return candles.keys.capacity() * sizeof(int64_t) +
+           (candles.opens.capacity() + candles.highs.capacity() + candles.lows.capacity() + candles.closes.capacity()) * sizeof(double) +
+           sizeof(Entry) + 4 * sizeof(void*) + sizeof(Key);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "CandlePyramid.h"
+#include "CandleSeries.h"
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/** what a cached result is the result of */
+enum class CachedOperation : uint8_t
+{
+    YearlyCandles, // stats and plot: yearly table candles, each with its table open
+    Candles,       // pyramid candles of one granularity
+    Predict        // ten-year forecast of one reference window
+};
+
+/** Bounded LRU cache of query results, shared by every query path and thread.
+ *
+ *  Entries are keyed by (operation, country, granularity, first, last), first and
+ *  last being years or period ordinals. Candle results don't depend on the range
+ *  they were asked for, so a request overlapping cached ranges takes their candles
+ *  and computes only the keys they miss; the pieces are merged into one entry
+ *  covering all of them. Ranges that only touch are kept apart, so a series asked
+ *  for piece by piece is not copied over and over. Forecasts are only reused for
+ *  the same window. Entries are immutable and shared, so candles are sliced and
+ *  joined outside the lock, which only guards the index.
+ *  The least recently used entries are evicted to stay under the byte limit, and
+ *  everything is dropped when the DataBook's data changes (see DataBook::generation).
+ *  Hits, partial hits and misses are counted in Metrics. */
+class QueryCache
+{
+    public:
+        QueryCache(size_t _byteLimit = DEFAULT_BYTE_LIMIT);
+
+        /** candles keyed within [first, last]; compute(from, to) is called for each range not cached
+         *  and must return the candles keyed within it, in key order */
+        CandleSeries candles(CachedOperation operation, Country country, Granularity granularity, int64_t first, int64_t last,
+                             const std::function<CandleSeries(int64_t, int64_t)>& compute);
+        /** the result for exactly [first, last], computed on a miss; a compute that throws caches nothing */
+        CandleSeries result(CachedOperation operation, Country country, Granularity granularity, int64_t first, int64_t last,
+                            const std::function<CandleSeries()>& compute);
+
+        /** 0 turns the cache off */
+        void setByteLimit(size_t bytes);
+        size_t byteLimit() const;
+        size_t bytes() const;
+        size_t entryCount() const;
+        void clear();
+
+        /** the cache the query paths share */
+        static QueryCache& shared();
+
+        static const size_t DEFAULT_BYTE_LIMIT = 16u << 20;
+
+    private:
+        class Key
+        {
+            public:
+                CachedOperation operation;
+                Country country;
+                Granularity granularity;
+                int64_t first;
+                int64_t last;
+
+                bool operator<(const Key& other) const;
+                /** same operation, country and granularity */
+                bool sameSeries(const Key& other) const;
+        };
+
+        class Entry
+        {
+            public:
+                Key key;
+                std::shared_ptr<const CandleSeries> candles;
+                size_t bytes;
+        };
+        typedef std::map<Key, std::list<Entry>::iterator> Index;
+
+        /** insert an entry as the most recently used and evict down to the limit; caller holds the lock */
+        void insert(const Key& key, std::shared_ptr<const CandleSeries> candles, size_t bytes);
+        void erase(Index::iterator position);
+        /** the first entry of key's series that may overlap [key.first, key.last]; caller holds the lock */
+        Index::iterator firstOverlap(const Key& key);
+        /** drop everything if the data changed since the entries were made; caller holds the lock */
+        void checkGeneration();
+        /** add the candles of from keyed within [first, last] to the end of to */
+        static void append(CandleSeries& to, const CandleSeries& from, int64_t first, int64_t last);
+        static size_t bytesOf(const CandleSeries& candles);
+
+        mutable std::mutex mutex;
+        size_t limit;
+        size_t used;
+        uint64_t generation;
+        std::list<Entry> entries; // most recently used first
+        Index index;
+};
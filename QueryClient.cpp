@@ -0,0 +1,194 @@
+#include "QueryClient.h"
+#include "QueryServer.h"
+#include "LatencyHistogram.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+QueryClient::QueryClient()
+: connection(-1)
+{
+}
+
+QueryClient::~QueryClient()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool QueryClient::connect(const std::string& address)
+{
+    std::cerr << "QueryClient::connect sockets are not supported on Windows" << std::endl;
+    return false;
+}
+
+void QueryClient::close()
+{
+}
+
+bool QueryClient::query(const std::string& query, std::string& answer)
+{
+    return false;
+}
+
+bool QueryClient::readAnswer(std::string& answer)
+{
+    return false;
+}
+
+#else
+
+bool QueryClient::connect(const std::string& address)
+{
+    close();
+    connection = QueryServer::connectTo(address);
+    return connection >= 0;
+}
+
+void QueryClient::close()
+{
+    if (connection >= 0)
+    {
+        ::close(connection);
+        connection = -1;
+    }
+    buffer.clear();
+}
+
+bool QueryClient::query(const std::string& query, std::string& answer)
+{
+    return QueryServer::sendAll(connection, query + "\n") && readAnswer(answer);
+}
+
+bool QueryClient::readAnswer(std::string& answer)
+{
+    char chunk[64 * 1024];
+    while (true)
+    {
+        // An answer ends with an empty line: "\n\n", or a lone "\n" for an answer without records
+        size_t end = (!buffer.empty() && buffer[0] == '\n') ? 0 : buffer.find("\n\n");
+        if (end != std::string::npos)
+        {
+            size_t length = (end == 0) ? 0 : end + 1;
+            answer.assign(buffer, 0, length);
+            buffer.erase(0, length + 1);
+            return true;
+        }
+
+        ssize_t n = ::recv(connection, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        buffer.append(chunk, static_cast<size_t>(n));
+    }
+}
+
+#endif
+
+int QueryClient::runQueries(const std::string& address, const std::vector<std::string>& queries, std::ostream& out)
+{
+    QueryClient client;
+    if (!client.connect(address))
+    {
+        std::cerr << "QueryClient::runQueries could not connect to " << address << std::endl;
+        return 1;
+    }
+
+    int errors = 0;
+    std::string answer;
+    for (const std::string& query : queries)
+    {
+        if (!client.query(query, answer))
+        {
+            std::cerr << "QueryClient::runQueries connection to " << address << " lost" << std::endl;
+            return errors + 1;
+        }
+        out << answer;
+        for (size_t pos = 0; pos < answer.size(); pos = answer.find('\n', pos) + 1)
+        {
+            if (answer.compare(pos, 6, "error,") == 0)
+                ++errors;
+        }
+    }
+    out.flush();
+    return errors;
+}
+
+int QueryClient::runLoad(const std::string& address, const std::vector<std::string>& queries,
+                         unsigned int connectionCount, size_t requestCount, std::ostream& out)
+{
+    if (queries.empty() || connectionCount == 0)
+    {
+        std::cerr << "QueryClient::runLoad needs at least one query and one connection" << std::endl;
+        return 1;
+    }
+
+    // Connect everyone first so the timing covers queries only
+    std::vector<QueryClient> clients(connectionCount);
+    for (QueryClient& client : clients)
+    {
+        if (!client.connect(address))
+        {
+            std::cerr << "QueryClient::runLoad could not connect to " << address << std::endl;
+            return 1;
+        }
+    }
+
+    LatencyHistogram roundTrips;
+    std::atomic<size_t> failures{0};
+    std::atomic<size_t> answerBytes{0};
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int t = 0; t < connectionCount; ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            std::string answer;
+            size_t bytes = 0;
+            for (size_t i = 0; i < requestCount; ++i)
+            {
+                const std::string& query = queries[(t + i) % queries.size()];
+                auto sent = std::chrono::steady_clock::now();
+                if (!clients[t].query(query, answer))
+                {
+                    failures.fetch_add(requestCount - i);
+                    break;
+                }
+                roundTrips.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sent).count());
+                bytes += answer.size();
+            }
+            answerBytes.fetch_add(bytes);
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    char line[256];
+    std::snprintf(line, sizeof(line), "load,connections=%u,requests=%zu,failed=%zu,seconds=%.3f,queries_per_sec=%.1f,mb_per_sec=%.2f",
+                  connectionCount, static_cast<size_t>(roundTrips.count()), failures.load(),
+                  seconds, roundTrips.count() / seconds, answerBytes.load() / seconds / 1e6);
+    out << line << "\n";
+    out << "load,round_trip," << roundTrips.summary() << "\n";
+
+    std::string serverLatency;
+    if (clients[0].query("latency", serverLatency))
+    {
+        out << serverLatency;
+    }
+    out.flush();
+    return failures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+/** Client side of the QueryServer protocol, plus a load generator to measure it. */
+class QueryClient
+{
+    public:
+        QueryClient();
+        ~QueryClient();
+        QueryClient(const QueryClient&) = delete;
+        QueryClient& operator=(const QueryClient&) = delete;
+
+        /** connect to a server address ("unix:<path>" or "[127.0.0.1:]<port>") */
+        bool connect(const std::string& address);
+        void close();
+
+        /** send one query and collect its answer (records without the closing empty line);
+         *  false if the connection broke */
+        bool query(const std::string& query, std::string& answer);
+
+        /** send every query in order and print the answers; returns the number of error records */
+        static int runQueries(const std::string& address, const std::vector<std::string>& queries, std::ostream& out);
+
+        /** open connectionCount connections, each sending requestCount queries taken round-robin
+         *  from queries and waiting for every answer. Prints throughput, round-trip latency and
+         *  the server's own latency record. returns non-zero on connection failures */
+        static int runLoad(const std::string& address, const std::vector<std::string>& queries,
+                           unsigned int connectionCount, size_t requestCount, std::ostream& out);
+
+    private:
+        /** read until an empty line ends the current answer */
+        bool readAnswer(std::string& answer);
+
+        int connection;
+        std::string buffer; // bytes received past the last answer
+};
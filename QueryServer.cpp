@@ -0,0 +1,459 @@
+#include "QueryServer.h"
+#include "MerkelMain.h"
+#include "DataBook.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <csignal>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const std::string UNIX_PREFIX = "unix:";
+
+#ifndef _WIN32
+    volatile std::sig_atomic_t stopRequested = 0;
+
+    void requestStop(int)
+    {
+        stopRequested = 1;
+    }
+
+    /** port of "<port>", "127.0.0.1:<port>" or "localhost:<port>"; false for anything else */
+    bool parseTcpAddress(const std::string& address, uint16_t& port)
+    {
+        std::string portText = address;
+        size_t colon = address.rfind(':');
+        if (colon != std::string::npos)
+        {
+            std::string host = address.substr(0, colon);
+            if (host != "127.0.0.1" && host != "localhost")
+            {
+                return false;
+            }
+            portText = address.substr(colon + 1);
+        }
+        if (portText.empty() || portText.size() > 5 || portText.find_first_not_of("0123456789") != std::string::npos)
+        {
+            return false;
+        }
+        unsigned long value = std::stoul(portText);
+        port = static_cast<uint16_t>(value);
+        return value > 0 && value < 65536;
+    }
+
+    bool unixAddress(const std::string& address, sockaddr_un& socketAddress)
+    {
+        std::string path = address.substr(UNIX_PREFIX.size());
+        if (path.empty() || path.size() >= sizeof(socketAddress.sun_path))
+        {
+            return false;
+        }
+        socketAddress = sockaddr_un{};
+        socketAddress.sun_family = AF_UNIX;
+        std::copy(path.begin(), path.end(), socketAddress.sun_path);
+        return true;
+    }
+
+    sockaddr_in loopbackAddress(uint16_t port)
+    {
+        sockaddr_in socketAddress{};
+        socketAddress.sin_family = AF_INET;
+        socketAddress.sin_port = htons(port);
+        socketAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return socketAddress;
+    }
+#endif
+}
+
+QueryServer::QueryServer(std::string _address, unsigned int threadCount)
+: address(std::move(_address)),
+  workerCount(threadCount == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threadCount),
+  stopping(false),
+  wakePipe{-1, -1}
+{
+}
+
+#ifdef _WIN32
+
+int QueryServer::run()
+{
+    std::cerr << "QueryServer::run serving is not supported on Windows" << std::endl;
+    return 1;
+}
+
+int QueryServer::connectTo(const std::string& address)
+{
+    return -1;
+}
+
+int QueryServer::listenOn(const std::string& address)
+{
+    return -1;
+}
+
+bool QueryServer::sendAll(int connection, const std::string& data)
+{
+    return false;
+}
+
+void QueryServer::workerLoop()
+{
+}
+
+bool QueryServer::answer(const Task& task)
+{
+    return false;
+}
+
+void QueryServer::dispatch(int connection, Connection& state)
+{
+}
+
+#else
+
+int QueryServer::run()
+{
+    // Build everything the DataBook would otherwise build lazily, so workers only ever read
+    DataBook::getCandlePyramid();
+
+    int listener = listenOn(address);
+    if (listener < 0 || ::pipe(wakePipe) != 0)
+    {
+        std::cerr << "QueryServer::run could not listen on " << address << std::endl;
+        return 1;
+    }
+
+    struct sigaction action{};
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    std::signal(SIGPIPE, SIG_IGN); // for platforms without MSG_NOSIGNAL
+
+    started = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < workerCount; ++i)
+    {
+        workers.emplace_back(&QueryServer::workerLoop, this);
+    }
+    std::cerr << "QueryServer::run serving on " << address << " with " << workerCount << " workers" << std::endl;
+
+    // Poll until a signal arrives; the timeout bounds how long noticing it takes
+    std::map<int, Connection> connections;
+    std::vector<pollfd> polled;
+    while (!stopRequested)
+    {
+        polled.clear();
+        polled.push_back(pollfd{listener, POLLIN, 0});
+        polled.push_back(pollfd{wakePipe[0], POLLIN, 0});
+        for (const auto& entry : connections)
+        {
+            if (!entry.second.busy)
+            {
+                polled.push_back(pollfd{entry.first, POLLIN, 0});
+            }
+        }
+        if (::poll(polled.data(), polled.size(), 250) <= 0)
+        {
+            continue;
+        }
+
+        // Connections whose answers have been sent can be read again
+        if (polled[1].revents & POLLIN)
+        {
+            char drain[256];
+            ssize_t ignored = ::read(wakePipe[0], drain, sizeof(drain));
+            (void)ignored;
+
+            std::vector<std::pair<int, bool>> done;
+            {
+                std::lock_guard<std::mutex> lock{queueMutex};
+                done.swap(finished);
+            }
+            for (const std::pair<int, bool>& entry : done)
+            {
+                if (entry.second)
+                {
+                    ::close(entry.first);
+                    connections.erase(entry.first);
+                }
+                else
+                {
+                    connections[entry.first].busy = false;
+                }
+            }
+        }
+
+        for (size_t i = 2; i < polled.size(); ++i)
+        {
+            if (!polled[i].revents)
+                continue;
+
+            int connection = polled[i].fd;
+            Connection& state = connections[connection];
+            char chunk[64 * 1024];
+            ssize_t n = ::recv(connection, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                ::close(connection);
+                connections.erase(connection);
+                continue;
+            }
+            state.buffer.append(chunk, static_cast<size_t>(n));
+            dispatch(connection, state);
+        }
+
+        if (polled[0].revents & POLLIN)
+        {
+            int connection = ::accept(listener, nullptr, nullptr);
+            if (connection >= 0)
+            {
+                int noDelay = 1; // no-op on unix sockets
+                ::setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+                connections[connection] = Connection{"", false};
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{queueMutex};
+        stopping = true;
+        tasks.clear();
+    }
+    queueReady.notify_all();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    for (const auto& entry : connections)
+    {
+        ::close(entry.first);
+    }
+    ::close(listener);
+    ::close(wakePipe[0]);
+    ::close(wakePipe[1]);
+    if (address.rfind(UNIX_PREFIX, 0) == 0)
+    {
+        ::unlink(address.substr(UNIX_PREFIX.size()).c_str());
+    }
+
+    std::cerr << "QueryServer::run stopped, " << latency.summary() << std::endl;
+    return 0;
+}
+
+void QueryServer::dispatch(int connection, Connection& state)
+{
+    Task task{connection, {}};
+    size_t start = 0;
+    size_t end;
+    while ((end = state.buffer.find('\n', start)) != std::string::npos)
+    {
+        task.lines.push_back(state.buffer.substr(start, end - start));
+        start = end + 1;
+    }
+    state.buffer.erase(0, start);
+
+    if (!task.lines.empty())
+    {
+        state.busy = true;
+        std::lock_guard<std::mutex> lock{queueMutex};
+        tasks.push_back(std::move(task));
+        queueReady.notify_one();
+    }
+}
+
+void QueryServer::workerLoop()
+{
+    while (true)
+    {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock{queueMutex};
+            queueReady.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (stopping)
+            {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+
+        bool keepOpen = answer(task);
+
+        {
+            std::lock_guard<std::mutex> lock{queueMutex};
+            finished.push_back(std::make_pair(task.connection, !keepOpen));
+        }
+        char wake = 1;
+        ssize_t ignored = ::write(wakePipe[1], &wake, 1);
+        (void)ignored;
+    }
+}
+
+bool QueryServer::answer(const Task& task)
+{
+    // Pipelined requests are answered in one send
+    std::string response;
+    for (std::string line : task.lines)
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        if (line == "quit")
+        {
+            sendAll(task.connection, response);
+            return false;
+        }
+        if (line.empty())
+            continue;
+
+        std::ostringstream out;
+        if (line == "latency")
+        {
+            out << latencyRecord() << "\n\n";
+            response += out.str();
+            continue;
+        }
+        if (line == "stats")
+        {
+            response += Metrics::toJson();
+            response += "\n";
+            continue;
+        }
+
+        auto queryStart = std::chrono::steady_clock::now();
+        MerkelMain::runQueryLine(line, out);
+        out << "\n";
+        response += out.str();
+        latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - queryStart).count());
+    }
+    return sendAll(task.connection, response);
+}
+
+bool QueryServer::sendAll(int connection, const std::string& data)
+{
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL; // a peer hanging up must not raise SIGPIPE
+#else
+    const int flags = 0;
+#endif
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        ssize_t n = ::send(connection, data.data() + sent, data.size() - sent, flags);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+int QueryServer::listenOn(const std::string& address)
+{
+    int listener = -1;
+    if (address.rfind(UNIX_PREFIX, 0) == 0)
+    {
+        sockaddr_un socketAddress;
+        if (!unixAddress(address, socketAddress))
+            return -1;
+        ::unlink(socketAddress.sun_path); // a stale socket file from an earlier run
+        listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener >= 0 && ::bind(listener, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress)) != 0)
+        {
+            ::close(listener);
+            return -1;
+        }
+    }
+    else
+    {
+        uint16_t port;
+        if (!parseTcpAddress(address, port))
+            return -1;
+        sockaddr_in socketAddress = loopbackAddress(port);
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        if (listener >= 0 && (::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+                              ::bind(listener, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress)) != 0))
+        {
+            ::close(listener);
+            return -1;
+        }
+    }
+
+    if (listener >= 0 && ::listen(listener, SOMAXCONN) != 0)
+    {
+        ::close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+int QueryServer::connectTo(const std::string& address)
+{
+    int connection = -1;
+    int result = -1;
+    if (address.rfind(UNIX_PREFIX, 0) == 0)
+    {
+        sockaddr_un socketAddress;
+        if (!unixAddress(address, socketAddress))
+            return -1;
+        connection = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connection >= 0)
+            result = ::connect(connection, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress));
+    }
+    else
+    {
+        uint16_t port;
+        if (!parseTcpAddress(address, port))
+            return -1;
+        sockaddr_in socketAddress = loopbackAddress(port);
+        connection = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (connection >= 0)
+        {
+            int noDelay = 1; // requests are single short lines
+            ::setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            result = ::connect(connection, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress));
+        }
+    }
+
+    if (connection >= 0 && result != 0)
+    {
+        ::close(connection);
+        return -1;
+    }
+    return connection;
+}
+
+#endif
+
+std::string QueryServer::latencyRecord() const
+{
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    char line[256];
+    std::snprintf(line, sizeof(line), "latency,%llu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f",
+                  static_cast<unsigned long long>(latency.count()), latency.mean() / 1e3,
+                  latency.percentile(0.50) / 1e3, latency.percentile(0.95) / 1e3, latency.percentile(0.99) / 1e3,
+                  latency.max() / 1e3, seconds > 0 ? latency.count() / seconds : 0.0);
+    return line;
+}
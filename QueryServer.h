@@ -0,0 +1,83 @@
+#pragma once
+
+#include "LatencyHistogram.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** Local query server over the loaded DataBook.
+ *
+ *  Listens on a Unix domain socket ("unix:<path>") or on localhost TCP ("<port>"
+ *  or "127.0.0.1:<port>"). The protocol is line based: every request line is a
+ *  batch query (see MerkelMain::runBatch) and is answered with its records
+ *  followed by an empty line. "latency" answers with the server's latency
+ *  record, "stats" with the Metrics report (one JSON line) and "quit" closes
+ *  the connection.
+ *
+ *  One thread polls every connection and hands the complete request lines of a
+ *  connection to a pool of worker threads, so any number of connections share
+ *  the workers; a connection has at most one batch of lines in flight, which
+ *  keeps its answers in order. The DataBook is fully loaded before the workers
+ *  start and never changes afterwards, so queries run side by side without any
+ *  lock around the data.
+ *  POSIX only; on Windows run() reports that serving is unsupported. */
+class QueryServer
+{
+    public:
+        /** threadCount 0 = one worker per hardware thread */
+        QueryServer(std::string _address, unsigned int threadCount = 0);
+
+        /** serve until SIGINT or SIGTERM; returns non-zero if the address cannot be served */
+        int run();
+
+        /** connected socket for an address in the format above, -1 on failure */
+        static int connectTo(const std::string& address);
+        /** write all of data to a socket; false if the peer went away */
+        static bool sendAll(int connection, const std::string& data);
+
+    private:
+        /** socket listening on address, -1 on failure */
+        static int listenOn(const std::string& address);
+
+        /** request lines of one connection, answered in order by one worker */
+        class Task
+        {
+            public:
+                int connection;
+                std::vector<std::string> lines;
+        };
+
+        /** a connection as seen by the polling thread */
+        class Connection
+        {
+            public:
+                std::string buffer; // received bytes not yet forming a whole line
+                bool busy;          // a worker is answering its lines
+        };
+
+        void workerLoop();
+        /** answer the lines of a task; false if the connection should be closed */
+        bool answer(const Task& task);
+        /** queue the complete lines buffered for a connection, if any */
+        void dispatch(int connection, Connection& state);
+        /** "latency,<queries>,<mean_us>,<p50_us>,<p95_us>,<p99_us>,<max_us>,<queries per second>" */
+        std::string latencyRecord() const;
+
+        std::string address;
+        unsigned int workerCount;
+
+        std::mutex queueMutex;
+        std::condition_variable queueReady;
+        std::deque<Task> tasks;
+        /** connections whose task is done, with true if they are to be closed */
+        std::vector<std::pair<int, bool>> finished;
+        bool stopping;
+        /** workers write a byte here to wake the polling thread when a task is done */
+        int wakePipe[2];
+
+        LatencyHistogram latency;
+        std::chrono::steady_clock::time_point started;
+};
@@ -0,0 +1,112 @@
+#include "RangeStatsIndex.h"
+#include <algorithm>
+
+RangeStatsIndex::RangeStatsIndex()
+: country(Country::UNKNOWN),
+  rows(0)
+{
+}
+
+void RangeStatsIndex::build(const DataBookColumns& columns, Country _country)
+{
+    clear();
+    country = _country;
+    rows = columns.rowCount();
+    size_t blocks = (rows + BLOCK_ROWS - 1) / BLOCK_ROWS;
+
+    prefixSums.reserve(blocks + 1);
+    prefixCounts.reserve(blocks + 1);
+    prefixSums.push_back(0.0);
+    prefixCounts.push_back(0);
+    std::vector<double> lows(blocks), highs(blocks);
+    for (size_t b = 0; b < blocks; ++b)
+    {
+        TemperatureSummary block = columns.summarise(country, b * BLOCK_ROWS, std::min(rows, (b + 1) * BLOCK_ROWS));
+        prefixSums.push_back(prefixSums.back() + block.sum);
+        prefixCounts.push_back(prefixCounts.back() + block.count);
+        lows[b] = block.min;
+        highs[b] = block.max;
+    }
+
+    // Level k from level k - 1: a run of 2^k blocks is two runs of 2^(k-1)
+    lowLevels.push_back(std::move(lows));
+    highLevels.push_back(std::move(highs));
+    for (size_t span = 2; span <= blocks; span *= 2)
+    {
+        const std::vector<double>& lowBelow = lowLevels.back();
+        const std::vector<double>& highBelow = highLevels.back();
+        size_t half = span / 2;
+        std::vector<double> lowLevel(blocks - span + 1), highLevel(blocks - span + 1);
+        for (size_t b = 0; b + span <= blocks; ++b)
+        {
+            lowLevel[b] = std::min(lowBelow[b], lowBelow[b + half]);
+            highLevel[b] = std::max(highBelow[b], highBelow[b + half]);
+        }
+        lowLevels.push_back(std::move(lowLevel));
+        highLevels.push_back(std::move(highLevel));
+    }
+}
+
+TemperatureSummary RangeStatsIndex::query(const DataBookColumns& columns, size_t firstRow, size_t lastRow) const
+{
+    lastRow = std::min(lastRow, rows);
+    firstRow = std::min(firstRow, lastRow);
+
+    // Whole blocks [firstBlock, lastBlock); a range inside one or two blocks is just summarised
+    size_t firstBlock = (firstRow + BLOCK_ROWS - 1) / BLOCK_ROWS;
+    size_t lastBlock = lastRow / BLOCK_ROWS;
+    if (firstBlock >= lastBlock)
+    {
+        return columns.summarise(country, firstRow, lastRow);
+    }
+
+    TemperatureSummary head = columns.summarise(country, firstRow, firstBlock * BLOCK_ROWS);
+    TemperatureSummary tail = columns.summarise(country, lastBlock * BLOCK_ROWS, lastRow);
+
+    int level = levelOf(lastBlock - firstBlock);
+    size_t second = lastBlock - (size_t{1} << level);
+    const std::vector<double>& lows = lowLevels[level];
+    const std::vector<double>& highs = highLevels[level];
+
+    TemperatureSummary summary;
+    summary.min = std::min({head.min, tail.min, lows[firstBlock], lows[second]});
+    summary.max = std::max({head.max, tail.max, highs[firstBlock], highs[second]});
+    summary.sum = head.sum + (prefixSums[lastBlock] - prefixSums[firstBlock]) + tail.sum;
+    summary.count = head.count + (prefixCounts[lastBlock] - prefixCounts[firstBlock]) + tail.count;
+    return summary;
+}
+
+void RangeStatsIndex::clear()
+{
+    country = Country::UNKNOWN;
+    rows = 0;
+    std::vector<double>().swap(prefixSums);
+    std::vector<size_t>().swap(prefixCounts);
+    std::vector<std::vector<double>>().swap(lowLevels);
+    std::vector<std::vector<double>>().swap(highLevels);
+}
+
+size_t RangeStatsIndex::rowCount() const
+{
+    return rows;
+}
+
+size_t RangeStatsIndex::capacityBytes() const
+{
+    size_t bytes = prefixSums.capacity() * sizeof(double) + prefixCounts.capacity() * sizeof(size_t);
+    for (size_t k = 0; k < lowLevels.size(); ++k)
+    {
+        bytes += (lowLevels[k].capacity() + highLevels[k].capacity()) * sizeof(double);
+    }
+    return bytes;
+}
+
+int RangeStatsIndex::levelOf(size_t blocks)
+{
+    int level = 0;
+    while (blocks >>= 1)
+    {
+        ++level;
+    }
+    return level;
+}
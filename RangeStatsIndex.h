@@ -0,0 +1,47 @@
+#pragma once
+
+#include "DataBookColumns.h"
+#include <cstddef>
+#include <vector>
+
+/** min, max, sum and count of one country's readings over any run of rows in constant time.
+ *
+ *  Rows are cut into blocks of BLOCK_ROWS. The index keeps prefix sums of the
+ *  readings and of their count at every block boundary, and a sparse table of block
+ *  minima and maxima (level k holds runs of 2^k blocks), so the whole blocks of a
+ *  query cost two lookups each. The partial blocks at either end, at most two,
+ *  are summarised from the columns. That keeps the index under a tenth of the
+ *  column's size, where per-row tables would take several times the column.
+ *  Sums come from prefix differences, so a mean may differ in the last bits from
+ *  the one a scan of the same rows gives. */
+class RangeStatsIndex
+{
+    public:
+        RangeStatsIndex();
+
+        /** index a country's column over all rows of columns; the column must be present */
+        void build(const DataBookColumns& columns, Country country);
+        /** summary of rows [firstRow, lastRow) of the country built for; columns must be the ones
+         *  built from, unchanged since */
+        TemperatureSummary query(const DataBookColumns& columns, size_t firstRow, size_t lastRow) const;
+
+        void clear();
+        size_t rowCount() const;
+        size_t capacityBytes() const;
+
+        /** the compressed block size, so a partial block decodes at most one CompressedColumn block */
+        static const size_t BLOCK_ROWS = CompressedColumn::BLOCK_ROWS;
+
+    private:
+        /** floor(log2(blocks)), for blocks > 0 */
+        static int levelOf(size_t blocks);
+
+        Country country;
+        size_t rows;
+        /** [b] = sum and count of the readings in blocks before b; one more entry than blocks */
+        std::vector<double> prefixSums;
+        std::vector<size_t> prefixCounts;
+        /** [k][b] = min and max of blocks [b, b + 2^k); +inf and -inf where they hold no reading */
+        std::vector<std::vector<double>> lowLevels;
+        std::vector<std::vector<double>> highLevels;
+};
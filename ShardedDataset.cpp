@@ -0,0 +1,370 @@
+#include "ShardedDataset.h"
+#include "CSVReader.h"
+#include "Metrics.h"
+#include "OHLCCache.h"
+#include "TimeIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    const std::string MANIFEST_EXTENSION = ".manifest";
+
+    bool isManifest(const std::string& source)
+    {
+        return source.size() > MANIFEST_EXTENSION.size() &&
+               source.compare(source.size() - MANIFEST_EXTENSION.size(), MANIFEST_EXTENSION.size(), MANIFEST_EXTENSION) == 0;
+    }
+}
+
+ShardedDataset::ShardedDataset()
+{
+}
+
+bool ShardedDataset::isSharded(const std::string& source)
+{
+    return isManifest(source) || std::filesystem::path(source).filename().string().find_first_of("*?") != std::string::npos;
+}
+
+std::vector<std::string> ShardedDataset::shardFiles(const std::string& source)
+{
+    std::vector<std::string> files;
+    std::filesystem::path sourcePath{source};
+    std::filesystem::path directory = sourcePath.parent_path();
+
+    if (isManifest(source))
+    {
+        std::ifstream manifest{source};
+        if (!manifest)
+        {
+            std::cerr << "ShardedDataset::shardFiles could not open manifest: " << source << std::endl;
+            throw std::runtime_error("Unable to open shard manifest.");
+        }
+
+        // Shards in manifest order, relative paths taken from the manifest's directory
+        std::string line;
+        while (std::getline(manifest, line))
+        {
+            size_t first = line.find_first_not_of(" \t\r");
+            size_t last = line.find_last_not_of(" \t\r");
+            if (first == std::string::npos || line[first] == '#')
+                continue;
+
+            std::filesystem::path shard{line.substr(first, last - first + 1)};
+            files.push_back(shard.is_relative() ? (directory / shard).string() : shard.string());
+        }
+    }
+    else
+    {
+        // Wildcards in the file name only; sidecar caches living next to the shards never match
+        std::string pattern = sourcePath.filename().string();
+        std::string cacheSuffix = OHLCCache::cacheFilename("");
+        std::error_code error;
+        for (const std::filesystem::directory_entry& entry :
+             std::filesystem::directory_iterator(directory.empty() ? "." : directory, error))
+        {
+            std::string name = entry.path().filename().string();
+            bool cache = name.size() > cacheSuffix.size() &&
+                         name.compare(name.size() - cacheSuffix.size(), cacheSuffix.size(), cacheSuffix) == 0;
+            if (entry.is_regular_file() && !cache && matchesGlob(name, pattern))
+            {
+                files.push_back((directory / name).string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+    }
+
+    if (files.empty())
+    {
+        std::cerr << "ShardedDataset::shardFiles no csv shards in " << source << std::endl;
+        throw std::runtime_error("No CSV shards found.");
+    }
+    return files;
+}
+
+void ShardedDataset::read(const std::vector<std::string>& csvFiles, DataBookColumns& columns, unsigned int threadCount,
+                          std::vector<DataBookColumns>& shards)
+{
+    // Shards parsed already are merged as they are; the others are parsed now
+    shards.resize(csvFiles.size());
+    std::vector<std::string> unreadFiles;
+    std::vector<size_t> unreadShards;
+    for (size_t s = 0; s < csvFiles.size(); ++s)
+    {
+        if (shards[s].rowCount() == 0)
+        {
+            unreadFiles.push_back(csvFiles[s]);
+            unreadShards.push_back(s);
+        }
+    }
+    if (!unreadFiles.empty())
+    {
+        std::vector<DataBookColumns> parsed;
+        CSVReader::readShards(unreadFiles, parsed, threadCount);
+        for (size_t i = 0; i < parsed.size(); ++i)
+        {
+            shards[unreadShards[i]] = std::move(parsed[i]);
+        }
+    }
+    reportOverlaps(csvFiles, shards);
+
+    MergeReport report = merge(shards, columns);
+    shards.clear();
+    if (report.repeatedHours > 0 || report.clashingReadings > 0)
+    {
+        std::cerr << "ShardedDataset::read " << report.repeatedHours << " duplicate timestamps within a shard, "
+                  << report.clashingReadings << " clashing readings dropped for the earlier ones" << std::endl;
+    }
+    std::cerr << "ShardedDataset::read merged " << csvFiles.size() << " shards into " << columns.rowCount() << " rows." << std::endl;
+}
+
+ShardedDataset::MergeReport ShardedDataset::merge(std::vector<DataBookColumns>& shards, DataBookColumns& columns)
+{
+    PhaseTimer timer{LoadPhase::Build};
+    MergeReport report{0, 0};
+
+    size_t totalRows = 0;
+    for (const DataBookColumns& shard : shards)
+    {
+        totalRows += shard.rowCount();
+    }
+    columns.clear();
+    columns.resize(totalRows);
+
+    // Next row of every shard by hour; equal hours come out in shard order, so the earlier shard's readings land first
+    using Cursor = std::pair<int64_t, size_t>;
+    std::priority_queue<Cursor, std::vector<Cursor>, std::greater<Cursor>> next;
+    std::vector<size_t> rows(shards.size(), 0);
+    for (size_t s = 0; s < shards.size(); ++s)
+    {
+        if (shards[s].rowCount() > 0)
+        {
+            next.push(Cursor{shards[s].hours[0], s});
+        }
+    }
+
+    size_t out = 0;
+    while (!next.empty())
+    {
+        int64_t hour = next.top().first;
+        size_t s = next.top().second;
+        next.pop();
+
+        // Rows of one hour from different shards (say, different regions) become one row
+        const DataBookColumns& shard = shards[s];
+        size_t row = rows[s]++;
+        if (out == 0 || columns.hours[out - 1] != hour)
+        {
+            columns.hours[out++] = hour;
+        }
+        else if (row > 0 && shard.hours[row - 1] == hour)
+        {
+            ++report.repeatedHours;
+        }
+        for (int c = 0; c < COUNTRY_COUNT; ++c)
+        {
+            double reading = shard.temperatures[c][row];
+            if (std::isnan(reading))
+                continue;
+
+            double& merged = columns.temperatures[c][out - 1];
+            if (std::isnan(merged))
+                merged = reading;
+            else
+                ++report.clashingReadings;
+        }
+
+        // A finished shard gives its memory back straight away
+        if (rows[s] < shard.rowCount())
+            next.push(Cursor{shard.hours[rows[s]], s});
+        else
+            shards[s] = DataBookColumns();
+    }
+
+    columns.resize(out);
+    return report;
+}
+
+bool ShardedDataset::readYearlyCandles(const std::vector<std::string>& csvFiles, OHLCTable& table, unsigned int threadCount,
+                                       std::vector<DataBookColumns>& shards)
+{
+    shards.clear();
+    shards.resize(csvFiles.size());
+    std::vector<OHLCTable> tables(csvFiles.size());
+    std::vector<std::string> staleFiles;
+    std::vector<size_t> staleShards;
+    {
+        PhaseTimer timer{LoadPhase::Io};
+        for (size_t s = 0; s < csvFiles.size(); ++s)
+        {
+            if (!OHLCCache::load(csvFiles[s], tables[s]))
+            {
+                staleFiles.push_back(csvFiles[s]);
+                staleShards.push_back(s);
+            }
+        }
+    }
+
+    // Only shards without an up to date cache are parsed, and their caches written for next time.
+    // Their columns are kept until the candles are known to merge, so a fallback to the readings
+    // does not parse them twice
+    if (!staleFiles.empty())
+    {
+        std::vector<DataBookColumns> parsed;
+        CSVReader::readShards(staleFiles, parsed, threadCount);
+        for (size_t i = 0; i < parsed.size(); ++i)
+        {
+            {
+                PhaseTimer timer{LoadPhase::Build};
+                TimeIndex index;
+                index.build(parsed[i].hours);
+                tables[staleShards[i]].build(parsed[i], index);
+            }
+            shards[staleShards[i]] = std::move(parsed[i]);
+            OHLCCache::save(staleFiles[i], tables[staleShards[i]]);
+        }
+    }
+    std::cerr << "ShardedDataset::readYearlyCandles " << csvFiles.size() - staleFiles.size() << " of "
+              << csvFiles.size() << " shards from their caches" << std::endl;
+
+    PhaseTimer timer{LoadPhase::Build};
+    int firstYear = std::numeric_limits<int>::max();
+    int lastYear = std::numeric_limits<int>::min();
+    for (const OHLCTable& shardTable : tables)
+    {
+        if (shardTable.lastYear() >= shardTable.firstYear())
+        {
+            firstYear = std::min(firstYear, shardTable.firstYear());
+            lastYear = std::max(lastYear, shardTable.lastYear());
+        }
+    }
+    if (firstYear > lastYear)
+    {
+        table.clear();
+        shards.clear();
+        return true;
+    }
+
+    // Each (country, year) cell must come from a single shard; means of two shards can't be told apart from duplicates
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    int yearCount = lastYear - firstYear + 1;
+    std::vector<OHLC> candles(static_cast<size_t>(COUNTRY_COUNT) * yearCount, OHLC{nan, nan, nan, nan});
+    std::vector<size_t> counts(candles.size(), 0);
+    for (const OHLCTable& shardTable : tables)
+    {
+        for (int c = 0; c < COUNTRY_COUNT; ++c)
+        {
+            for (int year = shardTable.firstYear(); year <= shardTable.lastYear(); ++year)
+            {
+                if (!shardTable.has(static_cast<Country>(c), year))
+                    continue;
+
+                size_t cell = static_cast<size_t>(c) * yearCount + (year - firstYear);
+                if (counts[cell] > 0)
+                {
+                    std::cerr << "ShardedDataset::readYearlyCandles shards share readings of "
+                              << DataBookEntry::countryToString(static_cast<Country>(c)) << " in " << year << std::endl;
+                    table.clear();
+                    return false;
+                }
+                candles[cell] = shardTable.at(static_cast<Country>(c), year);
+                counts[cell] = shardTable.count(static_cast<Country>(c), year);
+            }
+        }
+    }
+
+    // Opens follow the previous year's close across shard boundaries
+    for (int c = 0; c < COUNTRY_COUNT; ++c)
+    {
+        for (int y = 0; y < yearCount; ++y)
+        {
+            size_t cell = static_cast<size_t>(c) * yearCount + y;
+            if (counts[cell] > 0)
+            {
+                candles[cell].open = (y > 0 && counts[cell - 1] > 0) ? candles[cell - 1].close : nan;
+            }
+        }
+    }
+    table.assign(firstYear, yearCount, std::move(candles), std::move(counts));
+    shards.clear();
+    return true;
+}
+
+void ShardedDataset::reportOverlaps(const std::vector<std::string>& csvFiles, const std::vector<DataBookColumns>& shards)
+{
+    auto holds = [](const DataBookColumns& shard, int c)
+    {
+        const std::vector<double>& column = shard.temperatures[c];
+        return std::any_of(column.begin(), column.end(), [](double reading) { return !std::isnan(reading); });
+    };
+
+    // Only shards whose time spans meet are scanned for the countries they share
+    for (size_t a = 0; a < shards.size(); ++a)
+    {
+        for (size_t b = a + 1; b < shards.size(); ++b)
+        {
+            if (shards[a].rowCount() == 0 || shards[b].rowCount() == 0)
+                continue;
+
+            int64_t from = std::max(shards[a].hours.front(), shards[b].hours.front());
+            int64_t to = std::min(shards[a].hours.back(), shards[b].hours.back());
+            if (from > to)
+                continue;
+
+            int shared = 0;
+            for (int c = 0; c < COUNTRY_COUNT; ++c)
+            {
+                if (holds(shards[a], c) && holds(shards[b], c))
+                    ++shared;
+            }
+            if (shared > 0)
+            {
+                std::cerr << "ShardedDataset::read " << csvFiles[a] << " and " << csvFiles[b] << " overlap from "
+                          << TimeIndex::formatHour(from) << " to " << TimeIndex::formatHour(to)
+                          << " on " << shared << " countries" << std::endl;
+            }
+        }
+    }
+}
+
+bool ShardedDataset::matchesGlob(const std::string& name, const std::string& pattern)
+{
+    // Greedy match, backing up to the last '*' on a mismatch
+    size_t n = 0, p = 0;
+    size_t starPattern = std::string::npos, starName = 0;
+    while (n < name.size())
+    {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n]))
+        {
+            ++n;
+            ++p;
+        }
+        else if (p < pattern.size() && pattern[p] == '*')
+        {
+            starPattern = p++;
+            starName = n;
+        }
+        else if (starPattern != std::string::npos)
+        {
+            p = starPattern + 1;
+            n = ++starName;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*')
+    {
+        ++p;
+    }
+    return p == pattern.size();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "DataBookColumns.h"
+#include "OHLCTable.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** A dataset split over several csv shards, such as one file per decade or per region.
+ *
+ *  The shards are named by a manifest ("<name>.manifest", one csv per line relative
+ *  to the manifest, blank lines and '#' comments skipped) or by a glob on the file
+ *  name ("data/eu_*.csv", matched in name order). They are parsed side by side and
+ *  their sorted time axes k-way merged into one set of columns, the countries of all
+ *  shards side by side. Rows of the same hour from different shards become one row;
+ *  when two of them carry a reading of the same country the earlier shard wins and
+ *  the clash is reported.
+ *
+ *  Yearly candles come from each shard's own sidecar cache (see OHLCCache), so a
+ *  new shard only costs the parsing of that shard. */
+class ShardedDataset
+{
+    public:
+        ShardedDataset();
+
+        /** true if source names a manifest or a glob rather than a single file */
+        static bool isSharded(const std::string& source);
+        /** the csv files of a manifest or glob; throws std::runtime_error if there are none */
+        static std::vector<std::string> shardFiles(const std::string& source);
+
+        /** parse every shard on threadCount threads (0 = all hardware threads) and merge them into columns.
+         *  shards may hold columns already parsed, by shard (see readYearlyCandles); only the shards
+         *  without rows there are parsed. shards is emptied */
+        static void read(const std::vector<std::string>& csvFiles, DataBookColumns& columns, unsigned int threadCount,
+                         std::vector<DataBookColumns>& shards);
+
+        /** yearly candles of all shards from their sidecar caches, parsing (and caching) only the
+         *  shards whose cache is missing or stale. false if two shards hold readings of the same
+         *  country and year, which their candles alone cannot merge: load the readings instead,
+         *  passing read() the shards, which then hold the columns parsed here */
+        static bool readYearlyCandles(const std::vector<std::string>& csvFiles, OHLCTable& table, unsigned int threadCount,
+                                      std::vector<DataBookColumns>& shards);
+
+        /** what merging the shards found */
+        class MergeReport
+        {
+            public:
+                uint64_t repeatedHours;      // rows whose hour the same shard already had
+                uint64_t clashingReadings;   // readings dropped because an earlier row of the hour had one
+        };
+
+        /** k-way merge of time-sorted shards into columns, emptying the shards as it goes */
+        static MergeReport merge(std::vector<DataBookColumns>& shards, DataBookColumns& columns);
+
+    private:
+        /** print the shard pairs whose time spans overlap on a country they both hold */
+        static void reportOverlaps(const std::vector<std::string>& csvFiles, const std::vector<DataBookColumns>& shards);
+        /** true if name matches a pattern of '*' and '?' wildcards */
+        static bool matchesGlob(const std::string& name, const std::string& pattern);
+};
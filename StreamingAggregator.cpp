@@ -0,0 +1,193 @@
+#include "StreamingAggregator.h"
+#include "CSVReader.h"
+#include "Metrics.h"
+#include "TemperatureKernels.h"
+#include "TimeIndex.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+StreamingAggregator::StreamingAggregator(size_t _memoryLimit)
+: memoryLimit(_memoryLimit),
+  firstMonth(0),
+  rows(0),
+  peak(0)
+{
+}
+
+void StreamingAggregator::aggregate(const std::string& csvFile)
+{
+    // Half of the limit reads and parses blocks, the other half is left to the aggregates
+    size_t readBytes = 0;
+    rows += CSVReader::streamCSV(csvFile, memoryLimit / 2, [this, &readBytes](const DataBookColumns& block)
+    {
+        fold(block);
+        peak = std::max(peak, readBytes + aggregateBytes());
+        if (readBytes + aggregateBytes() > memoryLimit)
+        {
+            std::cerr << "StreamingAggregator::aggregate " << aggregateBytes() << " bytes of aggregates exceed the memory limit" << std::endl;
+            throw std::runtime_error("Aggregates outgrew the memory limit.");
+        }
+    }, readBytes);
+    peak = std::max(peak, readBytes + aggregateBytes());
+}
+
+void StreamingAggregator::clear()
+{
+    firstMonth = 0;
+    months.clear();
+    rows = 0;
+    peak = 0;
+}
+
+void StreamingAggregator::fold(const DataBookColumns& block)
+{
+    PhaseTimer timer{LoadPhase::Build};
+
+    // Rows of one month are usually adjacent: summarise each run of them in one kernel call per country
+    size_t runStart = 0;
+    while (runStart < block.rowCount())
+    {
+        int year, month, day, hour;
+        TimeIndex::civilFromHours(block.hours[runStart], year, month, day, hour);
+        int64_t monthStart = TimeIndex::epochHour(year, month, 1, 0);
+        int64_t monthEnd = (month == 12) ? TimeIndex::epochHour(year + 1, 1, 1, 0) : TimeIndex::epochHour(year, month + 1, 1, 0);
+
+        size_t runEnd = runStart + 1;
+        while (runEnd < block.rowCount() && block.hours[runEnd] >= monthStart && block.hours[runEnd] < monthEnd)
+        {
+            ++runEnd;
+        }
+
+        Aggregate* slot = monthSlot(static_cast<int64_t>(year) * 12 + (month - 1));
+        for (int c = 0; c < COUNTRY_COUNT; ++c)
+        {
+            const double* column = block.column(static_cast<Country>(c));
+            TemperatureSummary summary = TemperatureKernels::summarise(column + runStart, column + runEnd);
+            if (summary.count == 0)
+                continue;
+
+            Aggregate& a = slot[c];
+            a.high = std::max(a.high, summary.max);
+            a.low = std::min(a.low, summary.min);
+            a.sum += summary.sum;
+            a.count += summary.count;
+        }
+        runStart = runEnd;
+    }
+}
+
+StreamingAggregator::Aggregate* StreamingAggregator::monthSlot(int64_t month)
+{
+    const Aggregate empty{std::numeric_limits<double>::lowest(), std::numeric_limits<double>::max(), 0.0, 0};
+    if (months.empty())
+    {
+        firstMonth = month;
+    }
+
+    // Grow at the front for rows older than any seen so far, at the back for newer ones
+    if (month < firstMonth)
+    {
+        months.insert(months.begin(), static_cast<size_t>(firstMonth - month) * COUNTRY_COUNT, empty);
+        firstMonth = month;
+    }
+    size_t slot = static_cast<size_t>(month - firstMonth);
+    if ((slot + 1) * COUNTRY_COUNT > months.size())
+    {
+        months.resize((slot + 1) * COUNTRY_COUNT, empty);
+    }
+    return &months[slot * COUNTRY_COUNT];
+}
+
+size_t StreamingAggregator::aggregateBytes() const
+{
+    return months.capacity() * sizeof(Aggregate);
+}
+
+CandleSeries StreamingAggregator::candles(Country country, Granularity granularity) const
+{
+    CandleSeries series;
+    int c = static_cast<int>(country);
+    if (c < 0 || c >= COUNTRY_COUNT || (granularity != Granularity::Month && granularity != Granularity::Year))
+    {
+        return series;
+    }
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    size_t slots = months.size() / COUNTRY_COUNT;
+    bool yearly = (granularity == Granularity::Year);
+    double prevClose = nan;
+    int64_t prevPeriod = 0;
+    bool havePrev = false;
+
+    // Walk the months, merging a whole year first when candles are yearly
+    size_t slot = 0;
+    while (slot < slots)
+    {
+        int64_t period = yearly ? (firstMonth + static_cast<int64_t>(slot)) / 12 : firstMonth + static_cast<int64_t>(slot);
+        Aggregate a{std::numeric_limits<double>::lowest(), std::numeric_limits<double>::max(), 0.0, 0};
+        do
+        {
+            const Aggregate& m = months[slot * COUNTRY_COUNT + c];
+            if (m.count > 0)
+            {
+                a.high = std::max(a.high, m.high);
+                a.low = std::min(a.low, m.low);
+                a.sum += m.sum;
+                a.count += m.count;
+            }
+            ++slot;
+        } while (yearly && slot < slots && (firstMonth + static_cast<int64_t>(slot)) / 12 == period);
+
+        if (a.count == 0)
+        {
+            havePrev = false;
+            continue;
+        }
+        double close = a.sum / a.count;
+        double open = (havePrev && prevPeriod == period - 1) ? prevClose : nan;
+        series.push_back(period, OHLC{open, a.high, a.low, close});
+        prevClose = close;
+        prevPeriod = period;
+        havePrev = true;
+    }
+    return series;
+}
+
+void StreamingAggregator::yearTable(OHLCTable& table) const
+{
+    table.clear();
+    if (months.empty())
+    {
+        return;
+    }
+
+    int firstYear = static_cast<int>(firstMonth / 12);
+    int lastYear = static_cast<int>((firstMonth + static_cast<int64_t>(months.size() / COUNTRY_COUNT) - 1) / 12);
+    int yearCount = lastYear - firstYear + 1;
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    std::vector<OHLC> candles(static_cast<size_t>(COUNTRY_COUNT) * yearCount, OHLC{nan, nan, nan, nan});
+    std::vector<size_t> counts(candles.size(), 0);
+    for (int c = 0; c < COUNTRY_COUNT; ++c)
+    {
+        CandleSeries years = this->candles(static_cast<Country>(c), Granularity::Year);
+        for (size_t i = 0; i < years.size(); ++i)
+        {
+            size_t cell = static_cast<size_t>(c) * yearCount + static_cast<size_t>(years.keys[i] - firstYear);
+            candles[cell] = years.at(i);
+        }
+    }
+
+    // Counts come from the months again, candles() does not keep them
+    for (size_t slot = 0; slot < months.size() / COUNTRY_COUNT; ++slot)
+    {
+        int year = static_cast<int>((firstMonth + static_cast<int64_t>(slot)) / 12);
+        for (int c = 0; c < COUNTRY_COUNT; ++c)
+        {
+            counts[static_cast<size_t>(c) * yearCount + (year - firstYear)] += months[slot * COUNTRY_COUNT + c].count;
+        }
+    }
+    table.assign(firstYear, yearCount, std::move(candles), std::move(counts));
+}
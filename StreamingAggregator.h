@@ -0,0 +1,63 @@
+#pragma once
+
+#include "CandleSeries.h"
+#include "CandlePyramid.h"
+#include "DataBookColumns.h"
+#include "OHLCTable.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** Monthly and yearly candles of a csv too large to load.
+ *
+ *  The file is read in blocks sized to fit a memory ceiling. Each block's rows
+ *  are parsed into a small reusable set of columns and folded straight into
+ *  per-country, per-month aggregates (high, low, sum, count), so no raw rows
+ *  outlive their block. Rows may come in any order. Years are merged from their
+ *  months; opens follow the rest of the tool: the close of the previous period,
+ *  NaN when it has no readings. Memory is the read buffer, the block's columns
+ *  and 32 bytes per month and country, whatever the size of the file. */
+class StreamingAggregator
+{
+    public:
+        /** memoryLimit in bytes for the buffer, block columns and aggregates together */
+        StreamingAggregator(size_t _memoryLimit = DEFAULT_MEMORY_LIMIT);
+
+        /** fold in every row of a csv; throws std::runtime_error if the file cannot be read,
+         *  a line does not fit in a block or the aggregates outgrow the limit */
+        void aggregate(const std::string& csvFile);
+        void clear();
+
+        /** candles of a country keyed by period ordinal (see CandlePyramid::periodOf); Month or Year only */
+        CandleSeries candles(Country country, Granularity granularity) const;
+        /** the yearly candle table the same file would give when loaded (up to rounding of the means) */
+        void yearTable(OHLCTable& table) const;
+
+        uint64_t rowCount() const { return rows; }
+        /** most memory in use at once while aggregating */
+        size_t peakBytes() const { return peak; }
+
+        static const size_t DEFAULT_MEMORY_LIMIT = 256u << 20;
+
+    private:
+        class Aggregate
+        {
+            public:
+                double high;
+                double low;
+                double sum;
+                uint64_t count;
+        };
+
+        /** fold rows of a parsed block into the month aggregates */
+        void fold(const DataBookColumns& block);
+        /** aggregates of a month slot, growing the slots to hold it */
+        Aggregate* monthSlot(int64_t month);
+        size_t aggregateBytes() const;
+
+        size_t memoryLimit;
+        int64_t firstMonth;                 // month ordinal of slot 0 (year * 12 + month - 1)
+        std::vector<Aggregate> months;      // [slot * COUNTRY_COUNT + country], count 0 = no readings
+        uint64_t rows;
+        size_t peak;
+};
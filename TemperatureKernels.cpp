@@ -0,0 +1,293 @@
+#include "TemperatureKernels.h"
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TEMPERATURE_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    const int LANES = TemperatureLanes::LANES;
+
+    /** combine per-lane partials in a fixed order, then fold in the tail one by one */
+    TemperatureSummary combineLanes(const double* mins, const double* maxs, const double* sums,
+                                    const double* counts, const double* tail, const double* last)
+    {
+        TemperatureSummary summary;
+        summary.min = mins[0];
+        summary.max = maxs[0];
+        for (int j = 1; j < LANES; ++j)
+        {
+            if (mins[j] < summary.min)
+                summary.min = mins[j];
+            if (maxs[j] > summary.max)
+                summary.max = maxs[j];
+        }
+        summary.sum = ((sums[0] + sums[1]) + (sums[2] + sums[3])) + ((sums[4] + sums[5]) + (sums[6] + sums[7]));
+
+        double count = ((counts[0] + counts[1]) + (counts[2] + counts[3])) + ((counts[4] + counts[5]) + (counts[6] + counts[7]));
+        summary.count = static_cast<size_t>(count);
+
+        for (const double* p = tail; p != last; ++p)
+        {
+            double x = *p;
+            if (x != x) // NaN = missing reading
+                continue;
+            if (x < summary.min)
+                summary.min = x;
+            if (x > summary.max)
+                summary.max = x;
+            summary.sum += x;
+            ++summary.count;
+        }
+        return summary;
+    }
+
+    typedef const double* (*AccumulateFunction)(TemperatureLanes&, const double*, const double*);
+    typedef void (*DecodeFunction)(const uint16_t*, size_t, int32_t, double, uint16_t, double*);
+
+    AccumulateFunction pickKernel(const char** name)
+    {
+#ifdef TEMPERATURE_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            *name = "avx2";
+            return &TemperatureKernels::accumulateAVX2;
+        }
+        if (__builtin_cpu_supports("sse2"))
+        {
+            *name = "sse2";
+            return &TemperatureKernels::accumulateSSE2;
+        }
+#endif
+        *name = "scalar";
+        return &TemperatureKernels::accumulateScalar;
+    }
+
+    DecodeFunction pickDecoder()
+    {
+#ifdef TEMPERATURE_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return &TemperatureKernels::decodeFixedPointAVX2;
+        }
+#endif
+        return &TemperatureKernels::decodeFixedPointScalar;
+    }
+
+    const char* kernelNameValue = "scalar";
+    const AccumulateFunction accumulateKernel = pickKernel(&kernelNameValue);
+    const DecodeFunction decodeKernel = pickDecoder();
+}
+
+TemperatureKernels::TemperatureKernels()
+{
+}
+
+TemperatureSummary TemperatureKernels::summarise(const double* first, const double* last)
+{
+    TemperatureLanes lanes;
+    reset(lanes);
+    const double* tail = accumulateKernel(lanes, first, last);
+    return finish(lanes, tail, last);
+}
+
+void TemperatureKernels::reset(TemperatureLanes& lanes)
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    for (int j = 0; j < LANES; ++j)
+    {
+        lanes.mins[j] = inf;
+        lanes.maxs[j] = -inf;
+        lanes.sums[j] = 0.0;
+        lanes.counts[j] = 0.0;
+    }
+}
+
+const double* TemperatureKernels::accumulate(TemperatureLanes& lanes, const double* first, const double* last)
+{
+    return accumulateKernel(lanes, first, last);
+}
+
+TemperatureSummary TemperatureKernels::finish(const TemperatureLanes& lanes, const double* tail, const double* last)
+{
+    return combineLanes(lanes.mins, lanes.maxs, lanes.sums, lanes.counts, tail, last);
+}
+
+void TemperatureKernels::decodeFixedPoint(const uint16_t* codes, size_t n, int32_t base, double scale, uint16_t missingCode, double* out)
+{
+    decodeKernel(codes, n, base, scale, missingCode, out);
+}
+
+const char* TemperatureKernels::kernelName()
+{
+    return kernelNameValue;
+}
+
+TemperatureSummary TemperatureKernels::summariseScalar(const double* first, const double* last)
+{
+    TemperatureLanes lanes;
+    reset(lanes);
+    const double* tail = accumulateScalar(lanes, first, last);
+    return finish(lanes, tail, last);
+}
+
+const double* TemperatureKernels::accumulateScalar(TemperatureLanes& lanes, const double* first, const double* last)
+{
+    const double* p = first;
+    for (; last - p >= LANES; p += LANES)
+    {
+        for (int j = 0; j < LANES; ++j)
+        {
+            double x = p[j];
+            if (x != x)
+                continue;
+            if (x < lanes.mins[j])
+                lanes.mins[j] = x;
+            if (x > lanes.maxs[j])
+                lanes.maxs[j] = x;
+            lanes.sums[j] += x;
+            lanes.counts[j] += 1.0;
+        }
+    }
+    return p;
+}
+
+void TemperatureKernels::decodeFixedPointScalar(const uint16_t* codes, size_t n, int32_t base, double scale, uint16_t missingCode, double* out)
+{
+    // Exact integers divided once, so a code gives the same double as parsing its decimal text
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i] = (codes[i] == missingCode) ? nan : static_cast<double>(base + static_cast<int32_t>(codes[i])) / scale;
+    }
+}
+
+#ifdef TEMPERATURE_KERNELS_X86
+
+__attribute__((target("sse2")))
+TemperatureSummary TemperatureKernels::summariseSSE2(const double* first, const double* last)
+{
+    TemperatureLanes lanes;
+    reset(lanes);
+    const double* tail = accumulateSSE2(lanes, first, last);
+    return finish(lanes, tail, last);
+}
+
+__attribute__((target("sse2")))
+const double* TemperatureKernels::accumulateSSE2(TemperatureLanes& lanes, const double* first, const double* last)
+{
+    const __m128d inf = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    const __m128d negInf = _mm_set1_pd(-std::numeric_limits<double>::infinity());
+    const __m128d one = _mm_set1_pd(1.0);
+
+    // Four registers of two lanes cover lanes 0-7
+    __m128d mins[4], maxs[4], sums[4], counts[4];
+    for (int k = 0; k < 4; ++k)
+    {
+        mins[k] = _mm_loadu_pd(lanes.mins + 2 * k);
+        maxs[k] = _mm_loadu_pd(lanes.maxs + 2 * k);
+        sums[k] = _mm_loadu_pd(lanes.sums + 2 * k);
+        counts[k] = _mm_loadu_pd(lanes.counts + 2 * k);
+    }
+
+    const double* p = first;
+    for (; last - p >= LANES; p += LANES)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            __m128d x = _mm_loadu_pd(p + 2 * k);
+            __m128d valid = _mm_cmpord_pd(x, x);
+            __m128d forMin = _mm_or_pd(_mm_and_pd(valid, x), _mm_andnot_pd(valid, inf));
+            __m128d forMax = _mm_or_pd(_mm_and_pd(valid, x), _mm_andnot_pd(valid, negInf));
+            mins[k] = _mm_min_pd(forMin, mins[k]);
+            maxs[k] = _mm_max_pd(forMax, maxs[k]);
+            sums[k] = _mm_add_pd(sums[k], _mm_and_pd(valid, x));
+            counts[k] = _mm_add_pd(counts[k], _mm_and_pd(valid, one));
+        }
+    }
+
+    for (int k = 0; k < 4; ++k)
+    {
+        _mm_storeu_pd(lanes.mins + 2 * k, mins[k]);
+        _mm_storeu_pd(lanes.maxs + 2 * k, maxs[k]);
+        _mm_storeu_pd(lanes.sums + 2 * k, sums[k]);
+        _mm_storeu_pd(lanes.counts + 2 * k, counts[k]);
+    }
+    return p;
+}
+
+__attribute__((target("avx2")))
+TemperatureSummary TemperatureKernels::summariseAVX2(const double* first, const double* last)
+{
+    TemperatureLanes lanes;
+    reset(lanes);
+    const double* tail = accumulateAVX2(lanes, first, last);
+    return finish(lanes, tail, last);
+}
+
+__attribute__((target("avx2")))
+const double* TemperatureKernels::accumulateAVX2(TemperatureLanes& lanes, const double* first, const double* last)
+{
+    const __m256d inf = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    const __m256d negInf = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+    const __m256d one = _mm256_set1_pd(1.0);
+
+    // Two registers of four lanes cover lanes 0-7
+    __m256d mins[2], maxs[2], sums[2], counts[2];
+    for (int k = 0; k < 2; ++k)
+    {
+        mins[k] = _mm256_loadu_pd(lanes.mins + 4 * k);
+        maxs[k] = _mm256_loadu_pd(lanes.maxs + 4 * k);
+        sums[k] = _mm256_loadu_pd(lanes.sums + 4 * k);
+        counts[k] = _mm256_loadu_pd(lanes.counts + 4 * k);
+    }
+
+    const double* p = first;
+    for (; last - p >= LANES; p += LANES)
+    {
+        for (int k = 0; k < 2; ++k)
+        {
+            __m256d x = _mm256_loadu_pd(p + 4 * k);
+            __m256d valid = _mm256_cmp_pd(x, x, _CMP_ORD_Q);
+            mins[k] = _mm256_min_pd(_mm256_blendv_pd(inf, x, valid), mins[k]);
+            maxs[k] = _mm256_max_pd(_mm256_blendv_pd(negInf, x, valid), maxs[k]);
+            sums[k] = _mm256_add_pd(sums[k], _mm256_and_pd(valid, x));
+            counts[k] = _mm256_add_pd(counts[k], _mm256_and_pd(valid, one));
+        }
+    }
+
+    for (int k = 0; k < 2; ++k)
+    {
+        _mm256_storeu_pd(lanes.mins + 4 * k, mins[k]);
+        _mm256_storeu_pd(lanes.maxs + 4 * k, maxs[k]);
+        _mm256_storeu_pd(lanes.sums + 4 * k, sums[k]);
+        _mm256_storeu_pd(lanes.counts + 4 * k, counts[k]);
+    }
+    return p;
+}
+
+__attribute__((target("avx2")))
+void TemperatureKernels::decodeFixedPointAVX2(const uint16_t* codes, size_t n, int32_t base, double scale, uint16_t missingCode, double* out)
+{
+    const __m128i baseV = _mm_set1_epi32(base);
+    const __m128i missingV = _mm_set1_epi32(missingCode);
+    const __m256d scaleV = _mm256_set1_pd(scale);
+    const __m256d nanV = _mm256_set1_pd(std::numeric_limits<double>::quiet_NaN());
+
+    // Four codes at a time: widen to int32, add the base, convert exactly and divide once
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i code = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(codes + i)));
+        __m256d value = _mm256_div_pd(_mm256_cvtepi32_pd(_mm_add_epi32(code, baseV)), scaleV);
+        __m256d missing = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpeq_epi32(code, missingV)));
+        _mm256_storeu_pd(out + i, _mm256_blendv_pd(value, nanV, missing));
+    }
+    decodeFixedPointScalar(codes + i, n - i, base, scale, missingCode, out + i);
+}
+
+#endif
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/** min, max, sum and count of the non-missing readings in a range */
+class TemperatureSummary
+{
+    public:
+        double min;
+        double max;
+        double sum;
+        size_t count;
+};
+
+/** per-lane partials of a summary in progress; reading i of the input lands in lane i % LANES */
+class TemperatureLanes
+{
+    public:
+        static const int LANES = 8;
+
+        double mins[LANES];
+        double maxs[LANES];
+        double sums[LANES];
+        double counts[LANES];
+};
+
+/** Fused reduction kernels over contiguous readings.
+ *  One pass computes min, max, sum and count while skipping NaN (missing) readings.
+ *  AVX2 and SSE2 versions are picked at runtime from the CPU's features, with a
+ *  portable scalar fallback. All versions accumulate in the same eight lanes and
+ *  combine them in the same order, so they return bit-identical sums. */
+class TemperatureKernels
+{
+    public:
+        TemperatureKernels();
+
+        /** summary of [first, last); an empty summary has count 0, min +inf and max -inf */
+        static TemperatureSummary summarise(const double* first, const double* last);
+
+        /** Piecewise summarise, for readings that are not in memory all at once: after reset,
+         *  accumulate any number of chunks of whole lane groups, then finish with the last
+         *  partial group. Gives the same summary, bit for bit, as one summarise call. */
+        static void reset(TemperatureLanes& lanes);
+        /** fold the whole lane groups of [first, last) into lanes; returns where the leftover readings start */
+        static const double* accumulate(TemperatureLanes& lanes, const double* first, const double* last);
+        static TemperatureSummary finish(const TemperatureLanes& lanes, const double* tail, const double* last);
+
+        /** decode n fixed-point codes to (base + code) / scale, or NaN for missingCode */
+        static void decodeFixedPoint(const uint16_t* codes, size_t n, int32_t base, double scale, uint16_t missingCode, double* out);
+
+        /** name of the kernel picked for this CPU: "avx2", "sse2" or "scalar" */
+        static const char* kernelName();
+
+        static TemperatureSummary summariseScalar(const double* first, const double* last);
+        static const double* accumulateScalar(TemperatureLanes& lanes, const double* first, const double* last);
+        static void decodeFixedPointScalar(const uint16_t* codes, size_t n, int32_t base, double scale, uint16_t missingCode, double* out);
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        static TemperatureSummary summariseSSE2(const double* first, const double* last);
+        static TemperatureSummary summariseAVX2(const double* first, const double* last);
+        static const double* accumulateSSE2(TemperatureLanes& lanes, const double* first, const double* last);
+        static const double* accumulateAVX2(TemperatureLanes& lanes, const double* first, const double* last);
+        static void decodeFixedPointAVX2(const uint16_t* codes, size_t n, int32_t base, double scale, uint16_t missingCode, double* out);
+#endif
+};
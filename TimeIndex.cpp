@@ -0,0 +1,337 @@
+#include "TimeIndex.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+
+namespace
+{
+    int64_t floorDiv(int64_t a, int64_t b)
+    {
+        return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+    }
+}
+
+TimeIndex::TimeIndex()
+: baseYear(0)
+{
+}
+
+void TimeIndex::build(const std::vector<int64_t>& hours)
+{
+    clear();
+    if (hours.empty())
+    {
+        return;
+    }
+
+    int month, day, hour;
+    int lastYearSeen;
+    civilFromHours(hours.front(), baseYear, month, day, hour);
+    civilFromHours(hours.back(), lastYearSeen, month, day, hour);
+
+    // Every month slot starts at the first row at or after its first hour
+    long slotCount = (lastYearSeen - baseYear + 1) * 12L;
+    monthStarts.resize(slotCount + 1);
+    std::vector<int64_t>::const_iterator from = hours.begin();
+    for (long slot = 0; slot < slotCount; ++slot)
+    {
+        from = std::lower_bound(from, hours.end(), slotStart(slot));
+        monthStarts[slot] = static_cast<size_t>(from - hours.begin());
+    }
+    monthStarts[slotCount] = hours.size();
+}
+
+void TimeIndex::extend(const std::vector<int64_t>& hours, size_t firstNewRow)
+{
+    if (monthStarts.empty() || firstNewRow == 0)
+    {
+        build(hours);
+        return;
+    }
+    if (firstNewRow >= hours.size())
+    {
+        return;
+    }
+
+    int year, month, day, hour;
+    civilFromHours(hours.back(), year, month, day, hour);
+
+    // Grow the array for new years; slots past the old last row all start at the old row count
+    long slotCount = static_cast<long>(monthStarts.size()) - 1;
+    long neededSlots = (year - baseYear + 1) * 12L;
+    if (neededSlots > slotCount)
+    {
+        monthStarts.resize(neededSlots + 1, firstNewRow);
+        slotCount = neededSlots;
+    }
+
+    // Only those slots move, and only into the new rows
+    long slot = std::lower_bound(monthStarts.begin(), monthStarts.begin() + slotCount, firstNewRow) - monthStarts.begin();
+    std::vector<int64_t>::const_iterator from = hours.begin() + firstNewRow;
+    for (; slot < slotCount; ++slot)
+    {
+        from = std::lower_bound(from, hours.end(), slotStart(slot));
+        monthStarts[slot] = static_cast<size_t>(from - hours.begin());
+    }
+    monthStarts[slotCount] = hours.size();
+}
+
+void TimeIndex::clear()
+{
+    baseYear = 0;
+    monthStarts.clear();
+}
+
+bool TimeIndex::yearRows(int year, size_t& firstRow, size_t& lastRow) const
+{
+    long slot = (year - baseYear) * 12L;
+    if (monthStarts.empty() || slot < 0 || slot + 12 >= static_cast<long>(monthStarts.size()))
+    {
+        return false;
+    }
+
+    firstRow = monthStarts[slot];
+    lastRow = monthStarts[slot + 12];
+    return firstRow < lastRow;
+}
+
+bool TimeIndex::monthRows(int year, int month, size_t& firstRow, size_t& lastRow) const
+{
+    if (month < 1 || month > 12)
+    {
+        return false;
+    }
+    return monthSlotRows((year - baseYear) * 12L + (month - 1), firstRow, lastRow);
+}
+
+size_t TimeIndex::rowAtOrAfter(const std::vector<int64_t>& hours, int64_t hour) const
+{
+    if (monthStarts.empty())
+    {
+        return std::lower_bound(hours.begin(), hours.end(), hour) - hours.begin();
+    }
+
+    int year, month, day, hourOfDay;
+    civilFromHours(hour, year, month, day, hourOfDay);
+    long slot = (year - baseYear) * 12L + (month - 1);
+    if (slot < 0)
+    {
+        return 0;
+    }
+    if (slot + 1 >= static_cast<long>(monthStarts.size()))
+    {
+        return hours.size();
+    }
+
+    // Rows of the month hold hours of the month only, so the answer lies within them; with a
+    // reading every hour it sits at the hour's offset from the month start
+    size_t first = monthStarts[slot];
+    size_t last = monthStarts[slot + 1];
+    size_t guess = first + static_cast<size_t>(hour - slotStart(slot));
+    if (guess < last && hours[guess] == hour && (guess == first || hours[guess - 1] < hour))
+    {
+        return guess;
+    }
+    return std::lower_bound(hours.begin() + first, hours.begin() + last, hour) - hours.begin();
+}
+
+int64_t TimeIndex::slotStart(long slot) const
+{
+    return epochHour(baseYear + static_cast<int>(slot / 12), static_cast<int>(slot % 12) + 1, 1, 0);
+}
+
+bool TimeIndex::monthSlotRows(long slot, size_t& firstRow, size_t& lastRow) const
+{
+    if (monthStarts.empty() || slot < 0 || slot + 1 >= static_cast<long>(monthStarts.size()))
+    {
+        return false;
+    }
+
+    firstRow = monthStarts[slot];
+    lastRow = monthStarts[slot + 1];
+    return firstRow < lastRow;
+}
+
+int TimeIndex::firstYear() const
+{
+    return monthStarts.empty() ? -1 : baseYear;
+}
+
+int TimeIndex::lastYear() const
+{
+    return monthStarts.empty() ? -1 : baseYear + static_cast<int>((monthStarts.size() - 1) / 12) - 1;
+}
+
+int TimeIndex::nextYear(int year) const
+{
+    size_t firstRow, lastRow;
+    for (int y = std::max(year + 1, baseYear); y <= lastYear(); ++y)
+    {
+        if (yearRows(y, firstRow, lastRow))
+        {
+            return y;
+        }
+    }
+    return -1;
+}
+
+void TimeIndex::write(std::ostream& out) const
+{
+    int32_t year32 = baseYear;
+    uint64_t slots = monthStarts.size();
+    out.write(reinterpret_cast<const char*>(&year32), sizeof(year32));
+    out.write(reinterpret_cast<const char*>(&slots), sizeof(slots));
+    for (size_t start : monthStarts)
+    {
+        uint64_t start64 = start;
+        out.write(reinterpret_cast<const char*>(&start64), sizeof(start64));
+    }
+}
+
+bool TimeIndex::read(std::istream& in, size_t rowCount)
+{
+    clear();
+
+    int32_t year32 = 0;
+    uint64_t slots = 0;
+    if (!in.read(reinterpret_cast<char*>(&year32), sizeof(year32)) ||
+        !in.read(reinterpret_cast<char*>(&slots), sizeof(slots)) ||
+        slots > 12 * 100000 || (slots > 0 && (slots - 1) % 12 != 0))
+    {
+        return false;
+    }
+
+    baseYear = year32;
+    monthStarts.resize(static_cast<size_t>(slots));
+    for (size_t& start : monthStarts)
+    {
+        uint64_t start64 = 0;
+        in.read(reinterpret_cast<char*>(&start64), sizeof(start64));
+        start = static_cast<size_t>(start64);
+    }
+
+    // Lookups index the axis with these offsets unchecked
+    bool ordered = std::is_sorted(monthStarts.begin(), monthStarts.end());
+    size_t lastRow = monthStarts.empty() ? 0 : monthStarts.back();
+    if (!in || !ordered || lastRow != rowCount)
+    {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool TimeIndex::parseYearMonth(std::string_view timestamp, int& year, int& month)
+{
+    // "YYYY-MM..." with fixed positions
+    if (timestamp.size() < 7 || timestamp[4] != '-')
+    {
+        return false;
+    }
+
+    year = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        char ch = timestamp[i];
+        if (ch < '0' || ch > '9')
+            return false;
+        year = year * 10 + (ch - '0');
+    }
+
+    char m1 = timestamp[5];
+    char m2 = timestamp[6];
+    if (m1 < '0' || m1 > '1' || m2 < '0' || m2 > '9')
+    {
+        return false;
+    }
+    month = (m1 - '0') * 10 + (m2 - '0');
+    return month >= 1 && month <= 12;
+}
+
+bool TimeIndex::parseDateHour(std::string_view timestamp, int& year, int& month, int& day, int& hour)
+{
+    // "YYYY-MM-DDTHH" with fixed positions; a bare date counts as hour 0
+    if (!parseYearMonth(timestamp, year, month) || timestamp.size() < 10 || timestamp[7] != '-')
+    {
+        return false;
+    }
+
+    char d1 = timestamp[8];
+    char d2 = timestamp[9];
+    if (d1 < '0' || d1 > '3' || d2 < '0' || d2 > '9')
+    {
+        return false;
+    }
+    day = (d1 - '0') * 10 + (d2 - '0');
+
+    hour = 0;
+    if (timestamp.size() >= 13)
+    {
+        char h1 = timestamp[11];
+        char h2 = timestamp[12];
+        if (h1 < '0' || h1 > '2' || h2 < '0' || h2 > '9')
+        {
+            return false;
+        }
+        hour = (h1 - '0') * 10 + (h2 - '0');
+    }
+    return day >= 1 && day <= 31 && hour <= 23;
+}
+
+bool TimeIndex::parseEpochHour(std::string_view timestamp, int64_t& hour)
+{
+    int year, month, day, hourOfDay;
+    if (!parseDateHour(timestamp, year, month, day, hourOfDay))
+    {
+        return false;
+    }
+    hour = epochHour(year, month, day, hourOfDay);
+    return true;
+}
+
+int64_t TimeIndex::epochHour(int year, int month, int day, int hour)
+{
+    return daysFromCivil(year, month, day) * 24 + hour;
+}
+
+void TimeIndex::civilFromHours(int64_t hours, int& year, int& month, int& day, int& hour)
+{
+    int64_t days = floorDiv(hours, 24);
+    hour = static_cast<int>(hours - days * 24);
+    civilFromDays(days, year, month, day);
+}
+
+std::string TimeIndex::formatHour(int64_t hours)
+{
+    int year, month, day, hour;
+    civilFromHours(hours, year, month, day, hour);
+    char text[32];
+    std::snprintf(text, sizeof(text), "%04d-%02d-%02dT%02d:00:00Z", year, month, day, hour);
+    return text;
+}
+
+int64_t TimeIndex::daysFromCivil(int year, int month, int day)
+{
+    // Howard Hinnant's days_from_civil
+    int64_t y = static_cast<int64_t>(year) - (month <= 2 ? 1 : 0);
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+void TimeIndex::civilFromDays(int64_t days, int& year, int& month, int& day)
+{
+    // Howard Hinnant's civil_from_days
+    int64_t z = days + 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    day = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+    month = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    year = static_cast<int>(yoe + era * 400 + (month <= 2 ? 1 : 0));
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/** Calendar index over a sorted time axis of epoch hours (hours since 1970-01-01T00 UTC).
+ *  Maps every (year, month) between the first and last timestamp to its
+ *  contiguous block of rows, so year and month lookups are O(1). */
+class TimeIndex
+{
+    public:
+        TimeIndex();
+
+        /** index a sorted time axis */
+        void build(const std::vector<int64_t>& hours);
+        /** index rows appended from firstNewRow on; they must not be older than the rows before */
+        void extend(const std::vector<int64_t>& hours, size_t firstNewRow);
+        void clear();
+
+        /** rows [firstRow, lastRow) of a year; false if the year has no rows */
+        bool yearRows(int year, size_t& firstRow, size_t& lastRow) const;
+        /** rows [firstRow, lastRow) of a month (1-12); false if the month has no rows */
+        bool monthRows(int year, int month, size_t& firstRow, size_t& lastRow) const;
+        /** first row at or after an epoch hour, hours being the axis indexed. O(1) on an hourly
+         *  axis without gaps, otherwise a binary search of the hour's month only */
+        size_t rowAtOrAfter(const std::vector<int64_t>& hours, int64_t hour) const;
+
+        /** earliest year with data, -1 if empty */
+        int firstYear() const;
+        /** latest year with data, -1 if empty */
+        int lastYear() const;
+        /** next year with data after the sent year, -1 if there is none */
+        int nextYear(int year) const;
+
+        /** raw binary (native byte order) dump of the index, used by snapshots */
+        void write(std::ostream& out) const;
+        /** read a dump made by write() of an axis of rowCount rows; returns false and leaves the index
+         *  empty on a bad stream or on row offsets that run backwards or do not end at rowCount */
+        bool read(std::istream& in, size_t rowCount);
+
+        /** year and month digits of an ISO timestamp, without allocating */
+        static bool parseYearMonth(std::string_view timestamp, int& year, int& month);
+        /** year, month, day and hour of a "YYYY-MM-DDTHH..." timestamp, without allocating */
+        static bool parseDateHour(std::string_view timestamp, int& year, int& month, int& day, int& hour);
+        /** epoch hour of a "YYYY-MM-DDTHH..." timestamp; minutes and seconds are dropped */
+        static bool parseEpochHour(std::string_view timestamp, int64_t& hour);
+
+        /** epoch hour of a date and hour of the day */
+        static int64_t epochHour(int year, int month, int day, int hour);
+        /** date and hour of the day of an epoch hour */
+        static void civilFromHours(int64_t hours, int& year, int& month, int& day, int& hour);
+        /** "YYYY-MM-DDTHH:00:00Z" */
+        static std::string formatHour(int64_t hours);
+
+        /** days since 1970-01-01 of a proleptic Gregorian date */
+        static int64_t daysFromCivil(int year, int month, int day);
+        /** inverse of daysFromCivil */
+        static void civilFromDays(int64_t days, int& year, int& month, int& day);
+
+    private:
+        bool monthSlotRows(long slot, size_t& firstRow, size_t& lastRow) const;
+        /** epoch hour at which a month slot starts */
+        int64_t slotStart(long slot) const;
+
+        int baseYear;
+        /** monthStarts[k] = first row at or after month slot k, k = (year - baseYear) * 12 + month - 1.
+         *  Holds one extra trailing entry equal to the row count. */
+        std::vector<size_t> monthStarts;
+};
@@ -0,0 +1,378 @@
+// Offline microbenchmarks for the load, query, candle and forecast paths.
+//
+// Build (from the repository root):
+//   g++ -std=c++17 -O2 -pthread -DMERKEL_BENCHMARK *.cpp bench/*.cpp -o bench.exe
+// Run:
+//   bench.exe [--rows N] [--countries N] [--min-time SECONDS] [--filter TEXT]
+//
+// Every benchmark prints one JSON object per line on stdout, for example
+//   {"name":"csv.parse_text","iterations":12,"ns_per_op":4.1e+07,...}
+// Progress and the synthetic data location go to stderr.
+
+// The check harness (bench/Checks.cpp) brings its own main
+#ifndef MERKEL_TESTS
+
+#include "SyntheticData.h"
+#include "../CSVReader.h"
+#include "../BatchForecaster.h"
+#include "../Candlestick.h"
+#include "../DataBook.h"
+#include "../QueryCache.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Count every heap allocation of the process
+namespace
+{
+    std::atomic<size_t> allocationCount{0};
+}
+
+void* operator new(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+    /** stream buffer that drops everything, to silence cout while timing */
+    class NullBuffer : public std::streambuf
+    {
+        protected:
+            int overflow(int c) override { return c; }
+            std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+    };
+
+    long peakRssKb()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return static_cast<long>(counters.PeakWorkingSetSize / 1024);
+        return 0;
+#else
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss; // kilobytes on Linux
+#endif
+    }
+
+    class BenchmarkRunner
+    {
+        public:
+            BenchmarkRunner(std::ostream& _out, double _minSeconds, std::string _filter)
+            : out(_out),
+              minSeconds(_minSeconds),
+              filter(std::move(_filter))
+            {
+            }
+
+            /** time op until minSeconds have passed; itemsPerOp/bytesPerOp feed the throughput figures */
+            template <typename Op>
+            void run(const std::string& name, double itemsPerOp, double bytesPerOp, Op op)
+            {
+                if (!filter.empty() && name.find(filter) == std::string::npos)
+                    return;
+
+                std::cerr << "running " << name << std::endl;
+                op(); // warm up caches and lazy state
+
+                size_t iterations = 0;
+                size_t allocationsBefore = allocationCount.load();
+                auto start = std::chrono::steady_clock::now();
+                double elapsed = 0.0;
+                do
+                {
+                    op();
+                    ++iterations;
+                    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                } while (elapsed < minSeconds);
+                size_t allocations = allocationCount.load() - allocationsBefore;
+
+                double nsPerOp = elapsed * 1e9 / iterations;
+                char line[512];
+                std::snprintf(line, sizeof(line),
+                    "{\"name\":\"%s\",\"iterations\":%zu,\"ns_per_op\":%.6g,\"items_per_sec\":%.6g,"
+                    "\"bytes_per_sec\":%.6g,\"allocs_per_op\":%.6g,\"peak_rss_kb\":%ld}",
+                    name.c_str(), iterations, nsPerOp,
+                    itemsPerOp * iterations / elapsed, bytesPerOp * iterations / elapsed,
+                    static_cast<double>(allocations) / iterations, peakRssKb());
+                out << line << std::endl;
+            }
+
+        private:
+            std::ostream& out;
+            double minSeconds;
+            std::string filter;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    size_t rows = 40 * 8766; // 40 years of hourly rows
+    int countries = COUNTRY_COUNT;
+    double minSeconds = 0.5;
+    std::string filter;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string option = argv[i];
+        if (option == "--rows")
+            rows = std::stoul(argv[i + 1]);
+        else if (option == "--countries")
+            countries = std::stoi(argv[i + 1]);
+        else if (option == "--min-time")
+            minSeconds = std::stod(argv[i + 1]);
+        else if (option == "--filter")
+            filter = argv[i + 1];
+        else
+        {
+            std::cerr << "unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+
+    // Results keep the real stdout; everything the code under test prints is dropped
+    std::ostream results{std::cout.rdbuf()};
+    NullBuffer nullBuffer;
+    std::cout.rdbuf(&nullBuffer);
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "merkel_bench";
+    std::filesystem::create_directories(dir);
+    std::string csvFile = (dir / "synthetic.csv").string();
+    std::string snapshotFile = (dir / "synthetic.snap").string();
+
+    std::cerr << "generating " << rows << " rows x " << countries << " countries in " << csvFile << std::endl;
+    SyntheticData data{rows, countries};
+    std::string csvText = data.csvText();
+    data.writeCSV(csvFile);
+
+    size_t firstLineEnd = csvText.find('\n');
+    std::string sampleLine = csvText.substr(firstLineEnd + 1, csvText.find('\n', firstLineEnd + 1) - firstLineEnd - 1);
+    size_t cellsPerLine = static_cast<size_t>(countries) + 1;
+
+    BenchmarkRunner bench{results, minSeconds, filter};
+
+    // ---- parsing ----
+    bench.run("csv.tokenise.string", 1, sampleLine.size(), [&]()
+    {
+        std::vector<std::string> tokens = CSVReader::tokenise(sampleLine, ',');
+        if (tokens.size() != cellsPerLine)
+            std::abort();
+    });
+
+    std::vector<std::string_view> viewTokens;
+    bench.run("csv.tokenise.view", 1, sampleLine.size(), [&]()
+    {
+        CSVReader::tokenise(std::string_view{sampleLine}, ',', viewTokens);
+        if (viewTokens.size() != cellsPerLine)
+            std::abort();
+    });
+
+    bench.run("csv.parse_temperature", static_cast<double>(countries), sampleLine.size(), [&]()
+    {
+        double value, total = 0.0;
+        for (size_t i = 1; i < viewTokens.size(); ++i)
+        {
+            if (CSVReader::parseTemperature(viewTokens[i], value))
+                total += value;
+        }
+        if (total != total)
+            std::abort();
+    });
+
+    bench.run("csv.parse_text", static_cast<double>(rows), csvText.size(), [&]()
+    {
+        DataBookColumns columns;
+        CSVReader::parseCSV(csvText, columns);
+    });
+
+    bench.run("databook.load", static_cast<double>(rows), csvText.size(), [&]()
+    {
+        DataBook databook{csvFile, 1, false};
+    });
+
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    bench.run("databook.load.threads_" + std::to_string(threads), static_cast<double>(rows), csvText.size(), [&]()
+    {
+        DataBook databook{csvFile, threads, false};
+    });
+
+    {
+        DataBook databook{csvFile, threads, false};
+        databook.saveSnapshot(snapshotFile);
+    }
+    bench.run("databook.load.snapshot", static_cast<double>(rows), static_cast<double>(std::filesystem::file_size(snapshotFile)), [&]()
+    {
+        DataBook databook{snapshotFile};
+    });
+
+    // ---- queries, candles and forecasts on the csv-loaded book ----
+    DataBook databook{csvFile, threads, false};
+    int firstYear = std::stoi(databook.getEarliestYear());
+    int lastYear = DataBook::getYearlyCandles().lastYear();
+    int years = lastYear - firstYear + 1;
+    int queryCountries = std::min(countries, COUNTRY_COUNT);
+    std::string firstYearText = std::to_string(firstYear);
+    std::string lastYearText = std::to_string(lastYear);
+
+    int queryIndex = 0;
+    bench.run("databook.get_temperatures", static_cast<double>(rows) / years, 0, [&]()
+    {
+        Country country = static_cast<Country>(queryIndex % queryCountries);
+        int year = firstYear + (queryIndex / queryCountries) % years;
+        ++queryIndex;
+        TemperatureSummary summary = DataBook::getSummary(DataBook::getTemperatures(country, year));
+        if (summary.count > rows)
+            std::abort();
+    });
+
+    // 90-day windows at any offset, through the range index built by the first call
+    int64_t firstHour = TimeIndex::daysFromCivil(firstYear, 1, 1) * 24;
+    int64_t windowHours = 90 * 24;
+    int64_t windowStarts = std::max<int64_t>(1, static_cast<int64_t>(rows) - windowHours);
+    queryIndex = 0;
+    bench.run("databook.range_summary", static_cast<double>(windowHours), 0, [&]()
+    {
+        Country country = static_cast<Country>(queryIndex % queryCountries);
+        int64_t from = firstHour + (static_cast<int64_t>(queryIndex) * 7919) % windowStarts;
+        ++queryIndex;
+        TemperatureSummary summary = DataBook::getRangeSummary(country, from, from + windowHours - 1);
+        if (summary.count > rows)
+            std::abort();
+    });
+
+    // Candles are computed every time here; answers from the result cache are measured on their own below
+    QueryCache::shared().setByteLimit(0);
+    Candlestick candlestick;
+    queryIndex = 0;
+    bench.run("candlestick.get_data", years, 0, [&]()
+    {
+        Country country = static_cast<Country>(queryIndex++ % queryCountries);
+        CandleSeries candles = candlestick.getCandlestickData(country, firstYearText, lastYearText);
+        if (candles.empty())
+            std::abort();
+    });
+
+    CandleSeries chartData = candlestick.getCandlestickData(Country::AT, firstYearText, lastYearText);
+    bench.run("candlestick.plot_chart", years, 0, [&]()
+    {
+        candlestick.plotChart(Country::AT, firstYearText, lastYearText, chartData);
+    });
+
+    bench.run("candlestick.data_predict", years, 0, [&]()
+    {
+        CandleSeries predictions = candlestick.dataPredict(Country::AT, firstYearText, lastYearText, chartData);
+        if (predictions.size() != 10)
+            std::abort();
+    });
+
+    bench.run("candlestick.data_predict.all_countries", queryCountries, 0, [&]()
+    {
+        for (int c = 0; c < queryCountries; ++c)
+        {
+            Country country = static_cast<Country>(c);
+            CandleSeries reference = candlestick.getCandlestickData(country, firstYearText, lastYearText);
+            if (candlestick.dataPredict(country, firstYearText, lastYearText, reference).size() != 10)
+                std::abort();
+        }
+    });
+
+    QueryCache::shared().setByteLimit(QueryCache::DEFAULT_BYTE_LIMIT);
+    queryIndex = 0;
+    bench.run("candlestick.get_data.cached", years, 0, [&]()
+    {
+        Country country = static_cast<Country>(queryIndex++ % queryCountries);
+        CandleSeries candles = candlestick.getCandlestickData(country, firstYearText, lastYearText);
+        if (candles.empty())
+            std::abort();
+    });
+
+    std::vector<ForecastJob> forecastJobs = BatchForecaster::allCountries(firstYear, lastYear);
+    forecastJobs.resize(queryCountries);
+    bench.run("forecast.batch.all_countries", queryCountries, 0, [&]()
+    {
+        ForecastResults forecasts = BatchForecaster::forecast(forecastJobs, 10, 1);
+        if (forecasts.status[0] != ForecastStatus::OK)
+            std::abort();
+    });
+
+    // Many reference windows per country, as in a nightly run
+    std::vector<ForecastJob> windowJobs;
+    for (int c = 0; c < queryCountries; ++c)
+    {
+        for (int start = firstYear; start + 4 <= lastYear; ++start)
+        {
+            windowJobs.push_back(ForecastJob{static_cast<Country>(c), start, lastYear});
+        }
+    }
+    bench.run("forecast.batch.windows.threads_" + std::to_string(threads), static_cast<double>(windowJobs.size()), 0, [&]()
+    {
+        ForecastResults forecasts = BatchForecaster::forecast(windowJobs, 10, threads);
+        if (forecasts.status.size() != windowJobs.size())
+            std::abort();
+    });
+
+    // Every 10-year window of the data scored against the decade after it, one sliding pass per country
+    std::vector<Country> backtestCountries;
+    for (int c = 0; c < queryCountries; ++c)
+        backtestCountries.push_back(static_cast<Country>(c));
+    int backtestWindows = std::max(1, years - 9);
+    bench.run("forecast.backtest.all_countries", static_cast<double>(backtestWindows) * queryCountries, 0, [&]()
+    {
+        BacktestScores scores = BatchForecaster::backtest(backtestCountries, firstYear, lastYear, std::min(10, years), 10, 1);
+        if (scores.counts.size() != backtestCountries.size() * 10)
+            std::abort();
+    });
+
+    std::cout.rdbuf(results.rdbuf());
+    std::filesystem::remove_all(dir);
+    return 0;
+}
+
+#endif
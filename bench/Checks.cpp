@@ -0,0 +1,385 @@
+// Regression checks of the cached, indexed and sliding query paths against brute-force answers.
+//
+// Build (from the repository root):
+//   g++ -std=c++17 -O2 -pthread -DMERKEL_TESTS *.cpp bench/*.cpp -o checks.exe
+// Run:
+//   checks.exe [--rows N] [--filter TEXT]
+//
+// Every check prints "ok <name>" or "FAIL <name>: <first mismatch>" on stdout, and the
+// run exits with 1 if any check failed. Loading messages go to stderr.
+
+#ifdef MERKEL_TESTS
+
+#include "SyntheticData.h"
+#include "../CSVReader.h"
+#include "../BatchForecaster.h"
+#include "../Candlestick.h"
+#include "../DataBook.h"
+#include "../MerkelMain.h"
+#include "../QueryCache.h"
+#include "../RangeStatsIndex.h"
+#include "../TemperatureKernels.h"
+#include "../TimeIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    /** year whose rows are cut out of the synthetic data, so the time axis has a hole in it */
+    const int GAP_YEAR = 1984;
+
+    /** epoch hour of the synthetic data's first row, 1980-01-01T00 */
+    const int64_t FIRST_HOUR = 3652 * 24;
+
+    /** 64-bit LCG, so every run asks the same questions */
+    class CheckRandom
+    {
+        public:
+            CheckRandom(uint64_t _state)
+            : state(_state)
+            {
+            }
+
+            /** a number in [0, n) */
+            uint64_t below(uint64_t n)
+            {
+                state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+                return (state >> 11) % n;
+            }
+
+        private:
+            uint64_t state;
+    };
+
+    class CheckRunner
+    {
+        public:
+            CheckRunner(std::ostream& _out, std::string _filter)
+            : out(_out),
+              filter(std::move(_filter)),
+              failed(0)
+            {
+            }
+
+            /** run check, which returns its first mismatch or an empty string when it passes */
+            template <typename Check>
+            void run(const std::string& name, Check check)
+            {
+                if (!filter.empty() && name.find(filter) == std::string::npos)
+                    return;
+
+                std::cerr << "checking " << name << std::endl;
+                std::string mismatch = check();
+                if (mismatch.empty())
+                {
+                    out << "ok " << name << std::endl;
+                }
+                else
+                {
+                    out << "FAIL " << name << ": " << mismatch << std::endl;
+                    ++failed;
+                }
+            }
+
+            int failures() const { return failed; }
+
+        private:
+            std::ostream& out;
+            std::string filter;
+            int failed;
+    };
+
+    /** csv text without the rows of one year */
+    std::string withoutYear(const std::string& csvText, int year)
+    {
+        std::string prefix = std::to_string(year) + "-";
+        std::string kept;
+        kept.reserve(csvText.size());
+        size_t pos = 0;
+        while (pos < csvText.size())
+        {
+            size_t end = csvText.find('\n', pos);
+            end = (end == std::string::npos) ? csvText.size() : end + 1;
+            if (csvText.compare(pos, prefix.size(), prefix) != 0)
+            {
+                kept.append(csvText, pos, end - pos);
+            }
+            pos = end;
+        }
+        return kept;
+    }
+
+    /** hour bound of a query, "YYYY-MM-DDTHH" */
+    std::string hourBound(int64_t hour)
+    {
+        return TimeIndex::formatHour(hour).substr(0, 13);
+    }
+
+    std::string summaryText(const TemperatureSummary& summary)
+    {
+        std::ostringstream text;
+        text.precision(17);
+        text << "count " << summary.count << " min " << summary.min << " max " << summary.max << " sum " << summary.sum;
+        return text.str();
+    }
+
+    /** Candle, stats, plot and forecast queries over overlapping and touching ranges, answered
+     *  through the QueryCache at several sizes, twice over, must match the answers without it */
+    std::string checkQueryCache(size_t rows)
+    {
+        const char* const kinds[] = {"hourly", "daily", "weekly", "monthly", "yearly", "stats", "plot", "predict", "plot-daily"};
+        const int kindCount = sizeof(kinds) / sizeof(kinds[0]);
+        const int firstYear = 1980;
+        const int years = static_cast<int>(rows / 8766);
+
+        // A few countries and short spans, so ranges keep running into cached ones
+        CheckRandom random{22};
+        std::vector<std::string> queries;
+        for (int i = 0; i < 600; ++i)
+        {
+            std::string kind = kinds[random.below(kindCount)];
+            std::string country = DataBookEntry::countryToString(static_cast<Country>(random.below(3)));
+            std::string from, to;
+            if (kind == "hourly" || kind == "daily" || kind == "plot-daily")
+            {
+                int64_t spanHours = (kind == "hourly") ? 24 * 7 : 24 * 120;
+                int64_t first = FIRST_HOUR + static_cast<int64_t>(random.below(rows));
+                from = hourBound(first);
+                to = hourBound(first + static_cast<int64_t>(random.below(spanHours)));
+            }
+            else
+            {
+                int first = firstYear + static_cast<int>(random.below(years));
+                from = std::to_string(first);
+                to = std::to_string(first + static_cast<int>(random.below(6)));
+            }
+            queries.push_back(kind + "," + country + "," + from + "," + to);
+        }
+
+        QueryCache& cache = QueryCache::shared();
+        cache.clear();
+        cache.setByteLimit(0);
+        std::vector<std::string> expected;
+        for (const std::string& query : queries)
+        {
+            std::ostringstream answer;
+            MerkelMain::runQueryLine(query, answer);
+            expected.push_back(answer.str());
+        }
+
+        // 64K keeps evicting, the default size keeps everything
+        std::string mismatch;
+        for (size_t limit : {size_t{64} << 10, QueryCache::DEFAULT_BYTE_LIMIT})
+        {
+            cache.clear();
+            cache.setByteLimit(limit);
+            for (int pass = 0; pass < 2 && mismatch.empty(); ++pass)
+            {
+                for (size_t q = 0; q < queries.size() && mismatch.empty(); ++q)
+                {
+                    std::ostringstream answer;
+                    MerkelMain::runQueryLine(queries[q], answer);
+                    if (answer.str() != expected[q])
+                    {
+                        mismatch = queries[q] + " differs with a " + std::to_string(limit) + "-byte cache";
+                    }
+                }
+            }
+        }
+        cache.clear();
+        cache.setByteLimit(QueryCache::DEFAULT_BYTE_LIMIT);
+        return mismatch;
+    }
+
+    /** RangeStatsIndex::query over runs of rows inside a block, across block edges and over whole
+     *  columns, plain or compressed, must give the summary a scan of the same rows gives */
+    std::string checkRangeIndex(const std::string& csvText, bool compressed)
+    {
+        DataBookColumns columns;
+        CSVReader::parseCSV(csvText, columns);
+        if (compressed)
+        {
+            columns.compress();
+        }
+        const size_t rows = columns.rowCount();
+        const size_t block = RangeStatsIndex::BLOCK_ROWS;
+        std::vector<double> readings(rows);
+
+        CheckRandom random{24};
+        RangeStatsIndex index;
+        for (int c = 0; c < COUNTRY_COUNT; ++c)
+        {
+            Country country = static_cast<Country>(c);
+            index.build(columns, country);
+            columns.decode(country, 0, rows, readings.data());
+
+            std::vector<std::pair<size_t, size_t>> ranges = {{0, 0}, {0, rows}, {0, 1}, {rows - 1, rows}, {block, 2 * block},
+                                                             {block - 1, block + 1}, {1, rows - 1}, {block, rows}};
+            for (int i = 0; i < 300; ++i)
+            {
+                size_t first = random.below(rows + 1);
+                size_t length = random.below(i % 3 == 0 ? 2 * block : rows - first + 1);
+                ranges.push_back({first, std::min(rows, first + length)});
+            }
+
+            for (const std::pair<size_t, size_t>& range : ranges)
+            {
+                TemperatureSummary indexed = index.query(columns, range.first, range.second);
+                TemperatureSummary scanned = TemperatureKernels::summarise(readings.data() + range.first, readings.data() + range.second);
+                // Sums come from prefix differences, so only they may differ, in the last bits
+                if (indexed.count != scanned.count || indexed.min != scanned.min || indexed.max != scanned.max ||
+                    std::fabs(indexed.sum - scanned.sum) > 1e-6 * std::max(1.0, std::fabs(scanned.sum)))
+                {
+                    return DataBookEntry::countryToString(country) + " rows " + std::to_string(range.first) + " to " +
+                           std::to_string(range.second) + " give " + summaryText(indexed) + ", a scan " + summaryText(scanned);
+                }
+            }
+        }
+        return std::string{};
+    }
+
+    /** BatchForecaster::backtest, sliding one regression across the windows, must score what
+     *  refitting dataPredict on every window of windowYears within [firstYear, lastYear] scores */
+    std::string checkBacktest(int firstYear, int lastYear, int windowYears)
+    {
+        const int horizon = 10;
+        std::vector<Country> countries;
+        for (int c = 0; c < COUNTRY_COUNT; ++c)
+        {
+            countries.push_back(static_cast<Country>(c));
+        }
+        BacktestScores scores = BatchForecaster::backtest(countries, firstYear, lastYear, windowYears, horizon);
+
+        const OHLCTable& table = DataBook::getYearlyCandles();
+        Candlestick candlestick;
+        for (size_t c = 0; c < countries.size(); ++c)
+        {
+            std::vector<uint32_t> counts(horizon, 0);
+            std::vector<double> absoluteErrors(horizon * 4, 0.0);
+            std::vector<double> squaredErrors(horizon * 4, 0.0);
+            for (int start = firstYear; start + windowYears - 1 <= lastYear; ++start)
+            {
+                int end = start + windowYears - 1;
+                CandleSeries reference = candlestick.getCandlestickData(countries[c], std::to_string(start), std::to_string(end));
+
+                // A line through fewer than two whole candles has no slope and is not scored
+                int complete = 0;
+                for (size_t i = 0; i < reference.size(); ++i)
+                {
+                    if (!std::isnan(reference.opens[i]) && !std::isnan(reference.highs[i]) &&
+                        !std::isnan(reference.lows[i]) && !std::isnan(reference.closes[i]))
+                        ++complete;
+                }
+                if (complete < 2)
+                    continue;
+
+                CandleSeries predicted = candlestick.dataPredict(countries[c], std::to_string(start), std::to_string(end), reference);
+                for (int k = 0; k < horizon; ++k)
+                {
+                    int year = end + 1 + k;
+                    if (!table.has(countries[c], year))
+                        continue;
+                    const OHLC& actual = table.at(countries[c], year);
+                    if (std::isnan(actual.open) || std::isnan(actual.high) || std::isnan(actual.low) || std::isnan(actual.close))
+                        continue;
+                    const double errors[4] = {predicted.opens[k] - actual.open, predicted.highs[k] - actual.high,
+                                              predicted.lows[k] - actual.low, predicted.closes[k] - actual.close};
+                    ++counts[k];
+                    for (int v = 0; v < 4; ++v)
+                    {
+                        absoluteErrors[k * 4 + v] += std::fabs(errors[v]);
+                        squaredErrors[k * 4 + v] += errors[v] * errors[v];
+                    }
+                }
+            }
+
+            for (int k = 0; k < horizon; ++k)
+            {
+                size_t slot = scores.slot(c, k);
+                std::string where = DataBookEntry::countryToString(countries[c]) + " " + std::to_string(k + 1) + " years ahead";
+                if (scores.counts[slot] != counts[k])
+                {
+                    return where + " scores " + std::to_string(scores.counts[slot]) + " forecasts, refitting " +
+                           std::to_string(counts[k]);
+                }
+                for (int v = 0; v < 4 && counts[k] > 0; ++v)
+                {
+                    double mae = absoluteErrors[k * 4 + v] / counts[k];
+                    double rmse = std::sqrt(squaredErrors[k * 4 + v] / counts[k]);
+                    if (std::fabs(scores.mae(slot, v) - mae) > 1e-9 * std::max(1.0, mae) ||
+                        std::fabs(scores.rmse(slot, v) - rmse) > 1e-9 * std::max(1.0, rmse))
+                    {
+                        return where + " value " + std::to_string(v) + " has MAE " + std::to_string(scores.mae(slot, v)) +
+                               ", refitting " + std::to_string(mae);
+                    }
+                }
+            }
+        }
+        return std::string{};
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    size_t rows = 30 * 8766; // 30 years of hourly rows
+    std::string filter;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string option = argv[i];
+        if (option == "--rows")
+            rows = std::stoul(argv[i + 1]);
+        else if (option == "--filter")
+            filter = argv[i + 1];
+        else
+        {
+            std::cerr << "unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "merkel_checks";
+    std::filesystem::create_directories(dir);
+    std::string csvFile = (dir / "synthetic.csv").string();
+
+    std::cerr << "generating " << rows << " rows without " << GAP_YEAR << " in " << csvFile << std::endl;
+    std::string csvText = withoutYear(SyntheticData{rows, COUNTRY_COUNT}.csvText(), GAP_YEAR);
+    {
+        std::ofstream csv{csvFile, std::ios::binary | std::ios::trunc};
+        csv.write(csvText.data(), static_cast<std::streamsize>(csvText.size()));
+        if (!csv)
+        {
+            std::cerr << "could not write " << csvFile << std::endl;
+            return 1;
+        }
+    }
+
+    CheckRunner checks{std::cout, filter};
+    {
+        DataBook databook{csvFile, 0, false};
+
+        checks.run("query_cache", [&]() { return checkQueryCache(rows); });
+
+        // Windows that start, end or sit around the cut year, and a short range with one window
+        int lastYear = 1980 + static_cast<int>(rows / 8766) - 1;
+        for (int windowYears : {3, 5, 10})
+        {
+            checks.run("backtest." + std::to_string(windowYears), [&]() { return checkBacktest(1980, lastYear, windowYears); });
+        }
+        checks.run("backtest.one_window", [&]() { return checkBacktest(1981, 1985, 5); });
+    }
+    checks.run("range_index", [&]() { return checkRangeIndex(csvText, false); });
+    checks.run("range_index.compressed", [&]() { return checkRangeIndex(csvText, true); });
+
+    std::filesystem::remove_all(dir);
+    return checks.failures() == 0 ? 0 : 1;
+}
+
+#endif
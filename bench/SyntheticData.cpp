@@ -0,0 +1,79 @@
+#include "SyntheticData.h"
+#include "../TimeIndex.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    /** days from 1970-01-01 to 1980-01-01 */
+    const int64_t DAYS_TO_1980 = 3652;
+
+    const double PI = 3.14159265358979323846;
+
+    /** 64-bit LCG, good enough for noise and portable across compilers */
+    uint64_t nextRandom(uint64_t& state)
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return state >> 11;
+    }
+}
+
+SyntheticData::SyntheticData(size_t _rows, int _countries, uint64_t _seed)
+: rows(_rows),
+  countries(_countries),
+  seed(_seed)
+{
+}
+
+std::string SyntheticData::timestampOfHour(int64_t hour)
+{
+    return TimeIndex::formatHour(DAYS_TO_1980 * 24 + hour);
+}
+
+std::string SyntheticData::csvText() const
+{
+    std::string text = "utc_timestamp";
+    for (int c = 0; c < countries; ++c)
+    {
+        text += ",C" + std::to_string(c) + "_temperature";
+    }
+    text += '\n';
+    text.reserve(text.size() + rows * (21 + countries * 8));
+
+    uint64_t state = seed;
+    char cell[32];
+    for (size_t row = 0; row < rows; ++row)
+    {
+        text += timestampOfHour(static_cast<int64_t>(row));
+
+        // seasonal cycle + daily cycle + a slow trend + noise, per country offset
+        double season = 10.0 - 11.0 * std::cos(2.0 * PI * row / 8766.0);
+        double daily = -3.0 * std::cos(2.0 * PI * (row % 24) / 24.0);
+        double trend = row * 2.5e-6;
+        for (int c = 0; c < countries; ++c)
+        {
+            text += ',';
+            uint64_t r = nextRandom(state);
+            if (r % 1000 == 0)
+                continue; // about 0.1% missing readings
+            double noise = (static_cast<double>(r % 20000) / 10000.0 - 1.0) * 4.0;
+            int length = std::snprintf(cell, sizeof(cell), "%.3f", season + daily + trend + noise - 0.3 * c);
+            text.append(cell, static_cast<size_t>(length));
+        }
+        text += '\n';
+    }
+    return text;
+}
+
+void SyntheticData::writeCSV(const std::string& filename) const
+{
+    std::ofstream out{filename, std::ios::binary | std::ios::trunc};
+    std::string text = csvText();
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+    if (!out)
+    {
+        throw std::runtime_error("Unable to write " + filename);
+    }
+}
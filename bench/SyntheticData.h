@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/** Deterministic generator of weather csv text in the layout of the EU dataset:
+ *  a header, then one row per hour from 1980-01-01T00:00:00Z with one
+ *  temperature column per country. The same parameters always give the same bytes. */
+class SyntheticData
+{
+    public:
+        /** rows hourly rows, countries temperature columns (columns past the 28 known
+         *  countries are still written, so they only cost tokenising) */
+        SyntheticData(size_t rows, int countries, uint64_t seed = 1);
+
+        std::string csvText() const;
+        /** write csvText() to a file, throws std::runtime_error on failure */
+        void writeCSV(const std::string& filename) const;
+
+        /** ISO 8601 timestamp of an hour counted from 1980-01-01T00:00:00Z */
+        static std::string timestampOfHour(int64_t hour);
+
+    private:
+        size_t rows;
+        int countries;
+        uint64_t seed;
+};
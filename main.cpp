@@ -1,8 +1,322 @@
 #include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
 #include "MerkelMain.h"
+#include "QueryServer.h"
+#include "QueryClient.h"
+#include "OHLCCache.h"
+#include "QueryCache.h"
+#include "StreamingAggregator.h"
 
-int main()
+// The benchmark and check executables (bench/Benchmark.cpp, bench/Checks.cpp) bring their own main
+#if !defined(MERKEL_BENCHMARK) && !defined(MERKEL_TESTS)
+
+namespace
+{
+    void printUsage()
+    {
+        std::cerr << "usage: a.exe [dataset]                            interactive menu" << std::endl;
+        std::cerr << "       a.exe [dataset] --batch <script|->         run a query script" << std::endl;
+        std::cerr << "       a.exe [dataset] --query <query> ...        run queries given on the command line" << std::endl;
+        std::cerr << "             [--out-dir <dir>]                    one result file per query" << std::endl;
+        std::cerr << "       a.exe --make-snapshot <csv> <snapshot>     convert a csv into a binary snapshot" << std::endl;
+        std::cerr << "       a.exe [dataset] --serve <address>          serve queries on a local socket" << std::endl;
+        std::cerr << "             [--threads <n>]                      worker threads, default one per core" << std::endl;
+        std::cerr << "       a.exe --client <address> --query <query>   send queries to a server (or --batch)" << std::endl;
+        std::cerr << "       a.exe --load <address> --query <query>     load test a server with the queries" << std::endl;
+        std::cerr << "             [--connections <n>] [--requests <n>] concurrent connections, queries per connection" << std::endl;
+        std::cerr << "       a.exe <csv> --stream monthly|yearly         candles of every country without loading the csv" << std::endl;
+        std::cerr << "             [--memory <bytes>[K|M|G]]            memory ceiling, default 256M" << std::endl;
+        std::cerr << "       --stats <file|->                           write load and query metrics as JSON at exit" << std::endl;
+        std::cerr << "       --compress                                 keep readings as fixed-point blocks, about 4x less memory" << std::endl;
+        std::cerr << "       --lazy-columns                             parse a country's readings when a query first asks for it;" << std::endl;
+        std::cerr << "                                                  not with --serve" << std::endl;
+        std::cerr << "       --cache-bytes <bytes>[K|M|G]               query result cache size, default 16M, 0 = off" << std::endl;
+        std::cerr << "       --follow                                   pick up rows appended to the csv; batch queries" << std::endl;
+        std::cerr << "                                                  run again whenever new rows arrive; not with --serve" << std::endl;
+        std::cerr << "dataset: a csv, a snapshot, a <name>.manifest listing csv shards or a quoted glob such as 'data/eu_*.csv'" << std::endl;
+        std::cerr << "address: unix:<path>, <port> or 127.0.0.1:<port>" << std::endl;
+        std::cerr << "query: stats|plot|predict,<country|all>,<start year>,<end year>" << std::endl;
+        std::cerr << "       hourly|daily|weekly|monthly|yearly,<country|all>,<from>,<to>  e.g. daily,AT,1980-01-01,1980-01-31" << std::endl;
+        std::cerr << "       plot-hourly|plot-daily|...,<country|all>,<from>,<to>            chart of those candles" << std::endl;
+        std::cerr << "       <n>h|<n>d,<country|all>,<from>,<to>                           candles of n hours or days, e.g. 90d" << std::endl;
+        std::cerr << "       plot-<n>h|plot-<n>d,<country|all>,<from>,<to>                 chart of those candles" << std::endl;
+        std::cerr << "       window,<country|all>,<from>,<to>                              min, max, mean and count of the window" << std::endl;
+        std::cerr << "       backtest[-<n>],<country|all>,<start year>,<end year>          score forecasts of every n-year window, default 10" << std::endl;
+        std::cerr << "--width <n> narrows charts to n characters by merging neighbouring candles; the menu's charts default" << std::endl;
+        std::cerr << "            to the terminal width (COLUMNS, else 80)" << std::endl;
+    }
+
+    /** bytes from "<n>", "<n>K", "<n>M" or "<n>G" */
+    size_t parseBytes(const std::string& value)
+    {
+        size_t used = 0;
+        size_t bytes = std::stoul(value, &used);
+        std::string suffix = value.substr(used);
+        if (suffix == "K" || suffix == "k")
+            return bytes << 10;
+        if (suffix == "M" || suffix == "m")
+            return bytes << 20;
+        if (suffix == "G" || suffix == "g")
+            return bytes << 30;
+        if (!suffix.empty())
+            throw std::invalid_argument("unknown size suffix " + suffix);
+        return bytes;
+    }
+
+    /** stream a csv into monthly or yearly candles of every country, printed as candle query records.
+     *  The yearly table is kept in the csv's sidecar cache, so later runs skip parsing the rows */
+    int runStream(const std::string& csvFile, const std::string& kind, size_t memoryLimit)
+    {
+        Granularity granularity;
+        if (!CandlePyramid::parseGranularity(kind, granularity) ||
+            (granularity != Granularity::Month && granularity != Granularity::Year))
+        {
+            printUsage();
+            return 1;
+        }
+
+        StreamingAggregator aggregator{memoryLimit};
+        try
+        {
+            aggregator.aggregate(csvFile);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        std::cerr << "Streamed " << aggregator.rowCount() << " rows in at most " << aggregator.peakBytes() << " bytes." << std::endl;
+
+        std::cout << std::setprecision(8);
+        for (int c = 0; c < COUNTRY_COUNT; ++c)
+        {
+            std::string prefix = kind + "," + DataBookEntry::countryToString(static_cast<Country>(c)) + ",";
+            CandleSeries candles = aggregator.candles(static_cast<Country>(c), granularity);
+            for (size_t i = 0; i < candles.size(); ++i)
+            {
+                std::cout << prefix << CandlePyramid::periodLabel(granularity, candles.keys[i]) << "," << candles.opens[i] << ","
+                          << candles.highs[i] << "," << candles.lows[i] << "," << candles.closes[i] << "\n";
+            }
+        }
+        std::cout.flush();
+
+        if (aggregator.rowCount() > 0)
+        {
+            OHLCTable table;
+            aggregator.yearTable(table);
+            OHLCCache::save(csvFile, table);
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[])
 {   
-    MerkelMain app{};
-    app.init();
+    // a.exe --make-snapshot <csv> <snapshot> : convert a csv into a binary snapshot and exit
+    if (argc == 4 && std::string(argv[1]) == "--make-snapshot")
+    {
+        try
+        {
+            DataBook databook{argv[2], 0, false};
+            databook.saveSnapshot(argv[3]);
+            std::cout << "Wrote snapshot " << argv[3] << std::endl;
+            return 0;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    std::string dataset = "weather_data_EU_1980-2019_temp_only.csv";
+    std::vector<std::string> queries;
+    std::string outDir;
+    bool batch = false;
+    bool follow = false;
+    bool lazy = false;
+    bool widthGiven = false;
+    std::string serveAddress, clientAddress, loadAddress;
+    unsigned int serverThreads = 0;
+    unsigned int connections = 4;
+    size_t requests = 1000;
+    std::string streamKind;
+    size_t memoryLimit = StreamingAggregator::DEFAULT_MEMORY_LIMIT;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if ((arg == "--serve" || arg == "--client" || arg == "--load" || arg == "--threads" ||
+             arg == "--connections" || arg == "--requests" || arg == "--width" || arg == "--stats" ||
+             arg == "--stream" || arg == "--memory" || arg == "--cache-bytes") && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            try
+            {
+                if (arg == "--serve")
+                    serveAddress = value;
+                else if (arg == "--client")
+                    clientAddress = value;
+                else if (arg == "--load")
+                    loadAddress = value;
+                else if (arg == "--threads")
+                    serverThreads = static_cast<unsigned int>(std::stoul(value));
+                else if (arg == "--width")
+                {
+                    ChartRenderer::setDefaultWidth(std::stoul(value));
+                    widthGiven = true;
+                }
+                else if (arg == "--stats")
+                    Metrics::writeAtExit(value);
+                else if (arg == "--stream")
+                    streamKind = value;
+                else if (arg == "--memory")
+                    memoryLimit = parseBytes(value);
+                else if (arg == "--cache-bytes")
+                    QueryCache::shared().setByteLimit(parseBytes(value));
+                else if (arg == "--connections")
+                    connections = static_cast<unsigned int>(std::stoul(value));
+                else
+                    requests = std::stoul(value);
+            }
+            catch (const std::exception& e)
+            {
+                printUsage();
+                return 1;
+            }
+        }
+        else if ((arg == "--batch" || arg == "--query" || arg == "--out-dir") && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            batch = true;
+            if (arg == "--query")
+            {
+                queries.push_back(value);
+            }
+            else if (arg == "--out-dir")
+            {
+                outDir = value;
+            }
+            else
+            {
+                std::ifstream scriptFile;
+                if (value != "-")
+                {
+                    scriptFile.open(value);
+                    if (!scriptFile)
+                    {
+                        std::cerr << "Error: could not open query script " << value << std::endl;
+                        return 1;
+                    }
+                }
+                std::vector<std::string> script = MerkelMain::readQueryScript(value == "-" ? std::cin : scriptFile);
+                queries.insert(queries.end(), script.begin(), script.end());
+            }
+        }
+        else if (arg == "--follow")
+        {
+            follow = true;
+            DataBook::setFollowing(true);
+        }
+        else if (arg == "--compress")
+        {
+            DataBook::setCompressedStorage(true);
+        }
+        else if (arg == "--lazy-columns")
+        {
+            lazy = true;
+            DataBook::setLazyColumns(true);
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            printUsage();
+            return 1;
+        }
+        else
+        {
+            dataset = arg;
+        }
+    }
+
+    if (!streamKind.empty())
+    {
+        return runStream(dataset, streamKind, memoryLimit);
+    }
+
+    // Client and load generator talk to a running server and never load the dataset
+    if (!clientAddress.empty())
+    {
+        return QueryClient::runQueries(clientAddress, queries, std::cout) == 0 ? 0 : 2;
+    }
+    if (!loadAddress.empty())
+    {
+        return QueryClient::runLoad(loadAddress, queries, connections, requests, std::cout);
+    }
+
+    if (!serveAddress.empty())
+    {
+        // The server builds everything before it listens and never refreshes
+        if (follow || lazy)
+        {
+            std::cerr << "Error: --follow and --lazy-columns cannot be used with --serve" << std::endl;
+            return 1;
+        }
+        try
+        {
+            DataBook databook{dataset, 0};
+            QueryServer server{serveAddress, serverThreads};
+            return server.run();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    // The menu draws on the terminal, so its charts fit the terminal unless --width says otherwise
+    if (!batch)
+    {
+        if (!widthGiven)
+        {
+            ChartRenderer::setDefaultWidth(ChartRenderer::terminalWidth());
+        }
+        MerkelMain app{dataset, follow};
+        app.init();
+        return 0;
+    }
+
+    // Loading messages go to stderr, keeping stdout for results only. A dataset that cannot be
+    // loaded (or reloaded while following) ends the run with an error rather than an abort
+    try
+    {
+        MerkelMain app{dataset};
+
+        int failures = app.runBatch(queries, std::cout, outDir);
+
+        // Follow mode polls the csv once a second until interrupted
+        while (follow)
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            size_t added = DataBook::refresh();
+            if (added > 0)
+            {
+                std::cerr << "Picked up " << added << " new rows." << std::endl;
+                failures = app.runBatch(queries, std::cout, outDir);
+            }
+        }
+        return failures == 0 ? 0 : 2;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
 }
+
+#endif